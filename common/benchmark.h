@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm> // Needed for sort
+#include <chrono> // Needed for time measurements
+#include <cmath> // Needed for sqrt
+#include <iostream> // Needed for the pause and the statistics line
+#include <memory> // Needed for unique_ptr
+#include <vector> // Needed for the samples
+
+#include "options.h"
+#include "perf_counters.h"
+
+// Repeatable timing shared by the labs.
+//
+// A single run timed in whole milliseconds says little about small inputs: it shows 0 ms and the
+// speedup becomes 0. Every measurement here runs `warmupRuns` untimed runs first (page faults,
+// pool start-up, cache warm-up), then `repetitions` timed runs with a nanosecond clock, and
+// reports their median, which a single slow run cannot move, together with p95 and stddev.
+//
+// `--warmup=N`, `--repeat=N`, `--non-interactive` and `--perf` set it up for every lab the same way.
+
+struct BenchmarkSettings {
+    unsigned int warmupRuns = 0;
+    unsigned int repetitions = 1;
+    bool isInteractive = true; // Wait for a key press before the timed part
+    bool shouldCountEvents = false; // Hardware counters around the timed runs
+};
+
+// Settings of the whole program, set once in main by configureBenchmark
+inline BenchmarkSettings& benchmarkSettings() {
+    static BenchmarkSettings settings;
+    return settings;
+}
+
+inline void configureBenchmark(const Options& options) {
+    BenchmarkSettings& settings = benchmarkSettings();
+    settings.warmupRuns = std::max(0, options.getInt("warmup", settings.warmupRuns));
+    settings.repetitions = std::max(1, options.getInt("repeat", settings.repetitions));
+    settings.isInteractive = !options.has("non-interactive");
+    settings.shouldCountEvents = options.has("perf");
+}
+
+// Usage line of the shared flags
+inline const char* benchmarkUsage() {
+    return "--warmup=<runs> --repeat=<runs> --non-interactive --perf";
+}
+
+// "Press any key to continue..." unless the program runs non-interactively
+inline void waitForKeyPress() {
+    if (!benchmarkSettings().isInteractive) {
+        return;
+    }
+
+    std::cout << "Press any key to continue..." << std::endl;
+    std::cin.get();
+}
+
+// Summary of the timed runs, all in milliseconds
+struct TimingStats {
+    double median = 0;
+    double mean = 0;
+    double p95 = 0;
+    double stddev = 0;
+    double min = 0;
+    double max = 0;
+    unsigned int runs = 0;
+    CounterStats counters; // Only with --perf
+};
+
+inline TimingStats computeTimingStats(std::vector<double> samples) {
+    TimingStats stats;
+    stats.runs = samples.size();
+    if (samples.empty()) {
+        return stats;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    size_t count = samples.size();
+
+    stats.min = samples.front();
+    stats.max = samples.back();
+    stats.median = count % 2 == 1 ? samples[count / 2] : (samples[count / 2 - 1] + samples[count / 2]) / 2;
+
+    // Nearest-rank percentile
+    size_t p95Rank = (count * 95 + 99) / 100;
+    stats.p95 = samples[p95Rank > 0 ? p95Rank - 1 : 0];
+
+    double sum = 0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    stats.mean = sum / count;
+
+    double squares = 0;
+    for (double sample : samples) {
+        squares += (sample - stats.mean) * (sample - stats.mean);
+    }
+    stats.stddev = count > 1 ? std::sqrt(squares / (count - 1)) : 0;
+
+    return stats;
+}
+
+// Run `function` warmupRuns + repetitions times and time the repetitions. Every result but the
+// last is handed to `release`, the last one is returned so the caller can check it.
+template <typename Function, typename Release>
+auto measureRepeated(
+    Function function,
+    Release release,
+    TimingStats& stats
+) -> decltype(function()) {
+    const BenchmarkSettings& settings = benchmarkSettings();
+
+    // The counters are opened on the pool threads that exist, so the pool needs one run to start them all
+    unsigned int warmupRuns = settings.shouldCountEvents ? std::max(1u, settings.warmupRuns) : settings.warmupRuns;
+    for (unsigned int i = 0; i < warmupRuns; i++) {
+        release(function());
+    }
+
+    std::unique_ptr<ThreadCounters> counters;
+    if (settings.shouldCountEvents) {
+        counters.reset(new ThreadCounters());
+        counters->reset();
+    }
+
+    std::vector<double> samples;
+    auto timedRun = [&]() {
+        if (counters) {
+            counters->enable();
+        }
+        auto start = std::chrono::steady_clock::now();
+        auto result = function();
+        auto end = std::chrono::steady_clock::now();
+        if (counters) {
+            counters->disable();
+        }
+
+        samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        return result;
+    };
+
+    for (unsigned int i = 1; i < settings.repetitions; i++) {
+        release(timedRun());
+    }
+    auto result = timedRun();
+
+    stats = computeTimingStats(samples);
+    if (counters) {
+        stats.counters = counters->read(samples.size());
+    }
+    return result;
+}
+
+// "   - Runs: 10 (time above is the median, p95 1.5ms, stddev 0.1ms, min 1.1ms)", only when
+// more than one run was timed, so the output of a single run stays as it was, then the counters
+inline void printTimingStats(const TimingStats& stats) {
+    if (stats.runs > 1) {
+        std::cout << "   - Runs: " << stats.runs << " (time above is the median, p95 " << stats.p95
+                  << "ms, stddev " << stats.stddev << "ms, min " << stats.min << "ms)" << std::endl;
+    }
+
+    printCounterStats(stats.counters);
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <algorithm> // Needed for max
+#include <vector> // Needed for the CSR and ELLPACK arrays
+
+#include "thread_pool.h"
+
+// Compressed sparse row (and ELLPACK) storage shared by the labs that work on sparse matrices.
+//
+// Row i holds the nonzeros columns[rowStart[i]] .. columns[rowStart[i + 1] - 1] with the matching
+// values, so rowStart has rows + 1 entries and rowStart[rows] is the number of nonzeros.
+template <typename Value>
+struct CsrMatrix {
+    unsigned int rows = 0;
+    unsigned int cols = 0;
+    std::vector<size_t> rowStart; // size_t, a dense operand can have more than 2^32 nonzeros
+    std::vector<unsigned int> columns;
+    std::vector<Value> values;
+
+    size_t nonzeros() const {
+        return rowStart.empty() ? 0 : rowStart[rows];
+    }
+};
+
+// CSR copy of a dense matrix, `isNonzero(value)` decides which elements are kept.
+// Rows are counted and then filled in parallel, so building the copy is O(n * m / threads).
+template <typename Value, typename Dense, typename IsNonzero>
+CsrMatrix<Value> toCsrMatrix(
+    const Dense& matrix,
+    unsigned int rows,
+    unsigned int cols,
+    unsigned int numberOfThreads,
+    IsNonzero isNonzero
+) {
+    CsrMatrix<Value> csr;
+    csr.rows = rows;
+    csr.cols = cols;
+    csr.rowStart.assign(rows + 1, 0);
+
+    parallelFor(0, rows, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            unsigned int count = 0;
+            for (unsigned int j = 0; j < cols; j++) {
+                count += isNonzero(matrix[i][j]) ? 1 : 0;
+            }
+            csr.rowStart[i + 1] = count;
+        }
+    });
+
+    for (unsigned int i = 0; i < rows; i++) {
+        csr.rowStart[i + 1] += csr.rowStart[i];
+    }
+
+    csr.columns.resize(csr.nonzeros());
+    csr.values.resize(csr.nonzeros());
+
+    parallelFor(0, rows, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            size_t position = csr.rowStart[i];
+            for (unsigned int j = 0; j < cols; j++) {
+                if (isNonzero(matrix[i][j])) {
+                    csr.columns[position] = j;
+                    csr.values[position] = matrix[i][j];
+                    position++;
+                }
+            }
+        }
+    });
+
+    return csr;
+}
+
+// Part `threadIndex` of the rows when row i weighs prefix[i + 1] - prefix[i]: every part ends
+// at the first row where the running weight reaches its share, so the parts carry about the
+// same weight instead of the same number of rows. `prefix` has rows + 1 nondecreasing entries.
+inline Range partitionByWeight(
+    const std::vector<unsigned long long>& prefix,
+    unsigned int numberOfThreads,
+    unsigned int threadIndex
+) {
+    unsigned int rows = prefix.size() - 1;
+    unsigned long long total = prefix[rows];
+
+    auto boundary = [&](unsigned int part) -> unsigned int {
+        if (part == 0) {
+            return 0;
+        }
+        if (part >= numberOfThreads) {
+            return rows;
+        }
+
+        unsigned long long target = total * part / numberOfThreads;
+        unsigned int low = 0;
+        unsigned int high = rows;
+        // First row whose prefix reaches the target
+        while (low < high) {
+            unsigned int middle = low + (high - low) / 2;
+            if (prefix[middle] < target) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low;
+    };
+
+    return { boundary(threadIndex), boundary(threadIndex + 1) };
+}
+
+// Run `body(start, end)` on the shared pool for the weight-balanced parts of partitionByWeight
+template <typename Body>
+void parallelForWeighted(
+    const std::vector<unsigned long long>& prefix,
+    unsigned int numberOfThreads,
+    Body body
+) {
+    unsigned int rows = prefix.size() - 1;
+    numberOfThreads = effectiveThreads(rows, numberOfThreads);
+
+    if (numberOfThreads <= 1) {
+        if (rows > 0) {
+            body(0, rows);
+        }
+        return;
+    }
+
+    parallelRun(numberOfThreads, [&](unsigned int threadIndex) {
+        Range range = partitionByWeight(prefix, numberOfThreads, threadIndex);
+        if (range.start < range.end) {
+            body(range.start, range.end);
+        }
+    });
+}
+
+// Weight prefix of the rows of a CSR matrix: its nonzeros plus `rowOverhead` for the fixed
+// work every row costs (starting it, clearing its output), so empty rows are not free
+template <typename Value>
+std::vector<unsigned long long> nonzeroPrefix(
+    const CsrMatrix<Value>& matrix,
+    unsigned long long rowOverhead = 1
+) {
+    std::vector<unsigned long long> prefix(matrix.rows + 1, 0);
+    for (unsigned int i = 0; i < matrix.rows; i++) {
+        prefix[i + 1] = prefix[i] + (matrix.rowStart[i + 1] - matrix.rowStart[i]) + rowOverhead;
+    }
+    return prefix;
+}
+
+// ELLPACK storage: every row padded to `width` slots and stored slot by slot, slot k of row i at
+// k * rows + i. Consecutive rows are then consecutive in memory, so a block of rows can go through
+// its products one slot at a time in vector registers. Padding slots hold the value 0 and column 0,
+// so they are multiplied like the others. It pays off when the rows are about equally long:
+// one long row makes every row that long.
+template <typename Value>
+struct EllMatrix {
+    unsigned int rows = 0;
+    unsigned int cols = 0;
+    unsigned int width = 0;
+    std::vector<unsigned int> columns;
+    std::vector<Value> values;
+
+    size_t slot(unsigned int row, unsigned int k) const {
+        return size_t(k) * rows + row;
+    }
+};
+
+// ELLPACK copy of a CSR matrix, as wide as its longest row
+template <typename Value>
+EllMatrix<Value> toEllMatrix(
+    const CsrMatrix<Value>& csr,
+    unsigned int numberOfThreads
+) {
+    EllMatrix<Value> ell;
+    ell.rows = csr.rows;
+    ell.cols = csr.cols;
+    for (unsigned int i = 0; i < csr.rows; i++) {
+        ell.width = std::max(ell.width, (unsigned int)(csr.rowStart[i + 1] - csr.rowStart[i]));
+    }
+
+    ell.columns.assign(size_t(ell.width) * ell.rows, 0);
+    ell.values.assign(size_t(ell.width) * ell.rows, Value());
+
+    parallelFor(0, csr.rows, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            for (size_t position = csr.rowStart[i]; position < csr.rowStart[i + 1]; position++) {
+                size_t slot = ell.slot(i, position - csr.rowStart[i]);
+                ell.columns[slot] = csr.columns[position];
+                ell.values[slot] = csr.values[position];
+            }
+        }
+    });
+
+    return ell;
+}
+
+// Weight prefix of the rows of an ELLPACK matrix: padded or not, every row costs `width` slots,
+// so the parts of partitionByWeight have about the same number of rows
+template <typename Value>
+std::vector<unsigned long long> nonzeroPrefix(
+    const EllMatrix<Value>& matrix,
+    unsigned long long rowOverhead = 1
+) {
+    std::vector<unsigned long long> prefix(matrix.rows + 1, 0);
+    for (unsigned int i = 0; i < matrix.rows; i++) {
+        prefix[i + 1] = prefix[i] + matrix.width + rowOverhead;
+    }
+    return prefix;
+}
+
+// Rows of a square matrix grouped by color, so no two rows of a color have a nonzero in each
+// other's column: colorRows[colorStart[c]] .. colorRows[colorStart[c + 1] - 1] are the rows of color c,
+// in increasing order. All rows of a color can then be relaxed at once from the newest values.
+struct RowColoring {
+    std::vector<unsigned int> rows;
+    std::vector<unsigned int> colorStart;
+
+    unsigned int colorCount() const {
+        return colorStart.empty() ? 0 : colorStart.size() - 1;
+    }
+};
+
+// Greedy coloring of the graph of a square matrix, with an edge between i and j when A[i][j] or
+// A[j][i] is stored. Row i takes the smallest color none of its neighbours has, so a band of
+// width w needs w + 1 colors and scattered nonzeros add a few more.
+template <typename Value>
+RowColoring colorRows(const CsrMatrix<Value>& matrix) {
+    unsigned int n = matrix.rows;
+
+    // Rows that have i as a column, the other half of the symmetric pattern
+    std::vector<size_t> transposeStart(n + 1, 0);
+    for (size_t position = 0; position < matrix.nonzeros(); position++) {
+        transposeStart[matrix.columns[position] + 1]++;
+    }
+    for (unsigned int i = 0; i < n; i++) {
+        transposeStart[i + 1] += transposeStart[i];
+    }
+    std::vector<unsigned int> transposeRows(matrix.nonzeros());
+    std::vector<size_t> next(transposeStart.begin(), transposeStart.end() - 1);
+    for (unsigned int i = 0; i < n; i++) {
+        for (size_t position = matrix.rowStart[i]; position < matrix.rowStart[i + 1]; position++) {
+            transposeRows[next[matrix.columns[position]]++] = i;
+        }
+    }
+
+    std::vector<int> colors(n, -1);
+    std::vector<unsigned int> seenBy; // seenBy[c] == i + 1 when a neighbour of row i has color c
+    auto markNeighbour = [&](unsigned int i, unsigned int j) {
+        if (j != i && colors[j] >= 0) {
+            seenBy[colors[j]] = i + 1;
+        }
+    };
+
+    for (unsigned int i = 0; i < n; i++) {
+        for (size_t position = matrix.rowStart[i]; position < matrix.rowStart[i + 1]; position++) {
+            markNeighbour(i, matrix.columns[position]);
+        }
+        for (size_t position = transposeStart[i]; position < transposeStart[i + 1]; position++) {
+            markNeighbour(i, transposeRows[position]);
+        }
+
+        unsigned int color = 0;
+        while (color < seenBy.size() && seenBy[color] == i + 1) {
+            color++;
+        }
+        if (color == seenBy.size()) {
+            seenBy.push_back(0);
+        }
+        colors[i] = color;
+    }
+
+    RowColoring coloring;
+    coloring.colorStart.assign(seenBy.size() + 1, 0);
+    for (unsigned int i = 0; i < n; i++) {
+        coloring.colorStart[colors[i] + 1]++;
+    }
+    for (unsigned int color = 0; color < seenBy.size(); color++) {
+        coloring.colorStart[color + 1] += coloring.colorStart[color];
+    }
+    coloring.rows.resize(n);
+    std::vector<unsigned int> fill(coloring.colorStart.begin(), coloring.colorStart.end() - 1);
+    for (unsigned int i = 0; i < n; i++) {
+        coloring.rows[fill[colors[i]]++] = i;
+    }
+
+    return coloring;
+}
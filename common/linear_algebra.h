@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm> // Needed for max
+#include <vector> // Needed for the partial sums
+
+#include "thread_pool.h"
+
+// Vector kernels of the iterative solvers: dot products, axpy and dense matrix-vector products
+// on double vectors.
+//
+// Every kernel has a range form that works on the elements [start, end), for solvers that keep
+// their threads in one parallel region and already own a part of the rows, and a parallel form
+// that splits the rows itself on the shared pool.
+
+// Partial sum of one thread in its own cache line, so threads do not invalidate each other's sums
+struct alignas(64) PartialSum {
+    double value = 0.0;
+};
+
+// Dot product of `count` elements. Eight independent sums can live in vector registers;
+// a single running sum is a dependency chain the compiler may not reorder without -ffast-math.
+template <typename Value>
+inline double dotProduct(
+    const Value* a,
+    const double* b,
+    unsigned int count
+) {
+    double sums[8] = {};
+    unsigned int j = 0;
+
+    for (; j + 8 <= count; j += 8) {
+        for (unsigned int k = 0; k < 8; k++) {
+            sums[k] += a[j + k] * b[j + k];
+        }
+    }
+
+    double sum = ((sums[0] + sums[1]) + (sums[2] + sums[3])) + ((sums[4] + sums[5]) + (sums[6] + sums[7]));
+    for (; j < count; j++) {
+        sum += a[j] * b[j];
+    }
+
+    return sum;
+}
+
+// y[start, end) += alpha * x[start, end)
+inline void axpyRange(
+    double alpha,
+    const double* x,
+    double* y,
+    unsigned int start,
+    unsigned int end
+) {
+    for (unsigned int i = start; i < end; i++) {
+        y[i] += alpha * x[i];
+    }
+}
+
+// y[i] = A[i] . x for the rows [startRow, endRow) of a dense matrix with n columns
+template <typename Value>
+inline void multiplyRows(
+    Value** A,
+    const double* x,
+    double* y,
+    unsigned int n,
+    unsigned int startRow,
+    unsigned int endRow
+) {
+    for (unsigned int i = startRow; i < endRow; i++) {
+        y[i] = dotProduct(A[i], x, n);
+    }
+}
+
+// y = A x for a dense n x n matrix
+template <typename Value>
+void parallelMultiply(
+    Value** A,
+    const double* x,
+    double* y,
+    unsigned int n,
+    unsigned int numberOfThreads
+) {
+    parallelFor(0, n, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        multiplyRows(A, x, y, n, startRow, endRow);
+    });
+}
+
+// x . y of n elements. The partial sums are added in thread order, so the result only depends on
+// the number of threads, not on which thread finishes first.
+inline double parallelDot(
+    const double* x,
+    const double* y,
+    unsigned int n,
+    unsigned int numberOfThreads
+) {
+    numberOfThreads = std::max(1u, effectiveThreads(n, numberOfThreads));
+    std::vector<PartialSum> partialSums(numberOfThreads);
+
+    parallelRun(numberOfThreads, [&](unsigned int threadIndex) {
+        Range range = partitionRange(0, n, numberOfThreads, threadIndex);
+        partialSums[threadIndex].value = dotProduct(x + range.start, y + range.start, range.end - range.start);
+    });
+
+    double sum = 0.0;
+    for (const PartialSum& partialSum : partialSums) {
+        sum += partialSum.value;
+    }
+    return sum;
+}
+
+// y += alpha * x for n elements
+inline void parallelAxpy(
+    double alpha,
+    const double* x,
+    double* y,
+    unsigned int n,
+    unsigned int numberOfThreads
+) {
+    parallelFor(0, n, numberOfThreads, [&](unsigned int start, unsigned int end) {
+        axpyRange(alpha, x, y, start, end);
+    });
+}
@@ -0,0 +1,355 @@
+#pragma once
+
+#include <cstdint> // Needed for uintptr_t
+#include <fstream> // Needed to read the topology from sysfs
+#include <iostream> // Needed to print the placement report
+#include <sstream> // Needed to format the placement summary
+#include <string> // Needed for string
+#include <thread> // Needed for hardware_concurrency
+#include <vector> // Needed for the CPU lists
+
+#ifdef __linux__
+#include <sched.h> // Needed for sched_setaffinity and sched_getcpu
+#include <sys/syscall.h> // Needed for SYS_move_pages
+#include <unistd.h> // Needed for syscall and sysconf
+#endif
+
+#include "thread_pool.h"
+
+// NUMA helpers for the labs that stream big matrices (lab-1 and lab-2).
+//
+// Linux places a page on the node of the thread that first writes it. If the main thread
+// initializes a matrix, every page ends up on its node and the workers on the other socket
+// read remote memory. Initializing with the same `parallelFor` partition as the computation
+// puts every row on the node of the thread that later works on it, as long as the threads
+// do not migrate, which `pinThreads` makes sure of.
+//
+// On a single-node machine everything here is a no-op. `--simulate-numa=N` splits the CPUs
+// into N virtual nodes so the thread-to-node mapping and the placement report can still be
+// checked there; the pages themselves stay on the one real node.
+
+struct NumaTopology {
+    std::vector<std::vector<int>> cpusByNode;
+    bool isSimulated = false;
+
+    unsigned int nodeCount() const {
+        return cpusByNode.size();
+    }
+
+    int nodeOfCpu(int cpu) const {
+        for (unsigned int node = 0; node < cpusByNode.size(); node++) {
+            for (int nodeCpu : cpusByNode[node]) {
+                if (nodeCpu == cpu) {
+                    return node;
+                }
+            }
+        }
+        return -1;
+    }
+};
+
+// Parse a sysfs CPU or node list such as "0-3,8-11"
+inline std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string part;
+
+    while (std::getline(stream, part, ',')) {
+        if (part.empty()) {
+            continue;
+        }
+
+        size_t dash = part.find('-');
+        int first = std::stoi(part.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(part.substr(dash + 1));
+
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+#ifdef __linux__
+// Affinity mask of the process, read the first time it is needed. `pinThreads` narrows the mask of
+// the calling thread to one CPU, so reading it again afterwards would only see that CPU.
+inline const cpu_set_t& processCpuSet() {
+    static const cpu_set_t set = [] {
+        cpu_set_t initial;
+        CPU_ZERO(&initial);
+        if (sched_getaffinity(0, sizeof(initial), &initial) != 0) {
+            CPU_ZERO(&initial);
+        }
+        return initial;
+    }();
+    return set;
+}
+#endif
+
+// CPUs this process is allowed to run on
+inline std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+
+#ifdef __linux__
+    const cpu_set_t& set = processCpuSet();
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus.push_back(cpu);
+        }
+    }
+#endif
+
+    if (cpus.empty()) {
+        unsigned int count = std::thread::hardware_concurrency();
+        for (unsigned int cpu = 0; cpu < (count > 0 ? count : 1); cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+// Real topology from /sys/devices/system/node, or `simulatedNodes` virtual nodes when it is > 0
+inline NumaTopology detectNumaTopology(unsigned int simulatedNodes = 0) {
+    NumaTopology topology;
+    std::vector<int> cpus = allowedCpus();
+
+    if (simulatedNodes > 0) {
+        topology.isSimulated = true;
+        topology.cpusByNode.resize(simulatedNodes);
+
+        // Contiguous blocks of CPUs, like sockets; nodes share CPUs when there are fewer CPUs than nodes
+        for (unsigned int node = 0; node < simulatedNodes; node++) {
+            Range range = partitionRange(0, cpus.size(), simulatedNodes, node);
+            if (range.start == range.end) {
+                topology.cpusByNode[node].push_back(cpus[node % cpus.size()]);
+            }
+            for (unsigned int i = range.start; i < range.end; i++) {
+                topology.cpusByNode[node].push_back(cpus[i]);
+            }
+        }
+
+        return topology;
+    }
+
+#ifdef __linux__
+    std::ifstream onlineFile("/sys/devices/system/node/online");
+    std::string onlineNodes;
+    std::getline(onlineFile, onlineNodes);
+
+    for (int node : parseCpuList(onlineNodes)) {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string list;
+        std::getline(file, list);
+
+        std::vector<int> nodeCpus;
+        for (int cpu : parseCpuList(list)) {
+            for (int allowed : cpus) {
+                if (allowed == cpu) {
+                    nodeCpus.push_back(cpu);
+                    break;
+                }
+            }
+        }
+
+        // Memory-only nodes and nodes outside our affinity mask get no threads
+        if (!nodeCpus.empty()) {
+            topology.cpusByNode.push_back(nodeCpus);
+        }
+    }
+#endif
+
+    if (topology.cpusByNode.empty()) {
+        topology.cpusByNode.push_back(cpus);
+    }
+
+    return topology;
+}
+
+// Node of thread `threadIndex` out of `numberOfThreads`. Threads are given to nodes in contiguous
+// blocks, so the contiguous row ranges of `parallelFor` are contiguous per node as well.
+inline unsigned int nodeForThread(
+    const NumaTopology& topology,
+    unsigned int threadIndex,
+    unsigned int numberOfThreads
+) {
+    return (unsigned long long)threadIndex * topology.nodeCount() / numberOfThreads;
+}
+
+inline int cpuForThread(
+    const NumaTopology& topology,
+    unsigned int threadIndex,
+    unsigned int numberOfThreads
+) {
+    unsigned int node = nodeForThread(topology, threadIndex, numberOfThreads);
+
+    // Index of this thread among the threads of its node
+    unsigned int firstThreadOfNode = (node * numberOfThreads + topology.nodeCount() - 1) / topology.nodeCount();
+    const std::vector<int>& nodeCpus = topology.cpusByNode[node];
+
+    return nodeCpus[(threadIndex - firstThreadOfNode) % nodeCpus.size()];
+}
+
+inline bool pinCurrentThreadToCpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+inline int currentCpu() {
+#ifdef __linux__
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+// Pin every thread of a `numberOfThreads` region of the shared pool (including the calling thread)
+// to its CPU from `cpuForThread`. Pool threads keep their index between regions, so the pinning holds
+// for every later region with the same number of threads. Returns how many threads were pinned.
+inline unsigned int pinThreads(
+    const NumaTopology& topology,
+    unsigned int numberOfThreads
+) {
+    std::vector<char> isPinned(numberOfThreads, 0);
+
+#ifdef __linux__
+    // Give the calling thread the whole process mask back first, so pool threads it starts now do not
+    // inherit the single CPU it was pinned to by an earlier call
+    if (CPU_COUNT(&processCpuSet()) > 0) {
+        sched_setaffinity(0, sizeof(cpu_set_t), &processCpuSet());
+    }
+#endif
+
+    parallelRun(numberOfThreads, [&](unsigned int threadIndex) {
+        isPinned[threadIndex] = pinCurrentThreadToCpu(cpuForThread(topology, threadIndex, numberOfThreads));
+    });
+
+    unsigned int pinnedCount = 0;
+    for (char pinned : isPinned) {
+        pinnedCount += pinned;
+    }
+    return pinnedCount;
+}
+
+// Node holding each page that contains one of `addresses`, -1 when unknown
+// (no NUMA support in the kernel, page not touched yet, or not Linux)
+inline std::vector<int> queryPageNodes(const std::vector<const void*>& addresses) {
+    std::vector<int> nodes(addresses.size(), -1);
+
+#if defined(__linux__) && defined(SYS_move_pages)
+    if (addresses.empty()) {
+        return nodes;
+    }
+
+    std::vector<void*> pages;
+    long pageSize = sysconf(_SC_PAGESIZE);
+    for (const void* address : addresses) {
+        pages.push_back(reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(address) & ~uintptr_t(pageSize - 1)));
+    }
+
+    // With a null node list move_pages only reports where every page currently is
+    std::vector<int> status(pages.size(), -1);
+    if (syscall(SYS_move_pages, 0, pages.size(), pages.data(), nullptr, status.data(), 0) == 0) {
+        for (size_t i = 0; i < status.size(); i++) {
+            nodes[i] = status[i] >= 0 ? status[i] : -1;
+        }
+    }
+#endif
+
+    return nodes;
+}
+
+// "node 0: 12, node 1: 4" for the sampled pages, "unknown" when none could be queried
+inline std::string summarizePageNodes(const std::vector<int>& nodes) {
+    std::vector<unsigned int> counts;
+    for (int node : nodes) {
+        if (node >= 0) {
+            if ((unsigned int)node >= counts.size()) {
+                counts.resize(node + 1, 0);
+            }
+            counts[node]++;
+        }
+    }
+
+    std::string summary;
+    for (unsigned int node = 0; node < counts.size(); node++) {
+        if (counts[node] > 0) {
+            summary += (summary.empty() ? "" : ", ") + std::string("node ") + std::to_string(node) + ": " + std::to_string(counts[node]);
+        }
+    }
+
+    return summary.empty() ? "unknown" : summary;
+}
+
+// `--pin`, `--numa-placement` and `--simulate-numa=N` of lab-1 and lab-2
+struct NumaSettings {
+    bool shouldPinThreads = false;
+    bool shouldPrintPlacement = false;
+    unsigned int simulatedNodes = 0;
+};
+
+// Detect the topology and pin the `numberOfThreads` pool threads if asked to
+inline NumaTopology setUpNuma(
+    const NumaSettings& settings,
+    unsigned int numberOfThreads
+) {
+    NumaTopology topology = detectNumaTopology(settings.simulatedNodes);
+
+    if (settings.shouldPinThreads || settings.shouldPrintPlacement) {
+        std::cout << "- NUMA nodes: " << topology.nodeCount() << (topology.isSimulated ? " (simulated)" : "") << std::endl;
+    }
+
+    if (settings.shouldPinThreads) {
+        unsigned int pinnedCount = pinThreads(topology, numberOfThreads);
+        std::cout << "- Pinned " << pinnedCount << " of " << numberOfThreads << " threads:";
+        for (unsigned int t = 0; t < numberOfThreads; t++) {
+            std::cout << " " << t << "->cpu" << cpuForThread(topology, t, numberOfThreads);
+        }
+        std::cout << std::endl;
+    }
+
+    return topology;
+}
+
+// For every part of the `rows` rows that `parallelFor` gives to a thread, print the node the
+// thread runs on and where the sampled pages of its rows are. `rowAddress(i)` is the start of row i.
+template <typename RowAddress>
+void printNumaPlacement(
+    const NumaTopology& topology,
+    const std::string& name,
+    unsigned int rows,
+    unsigned int numberOfThreads,
+    RowAddress rowAddress
+) {
+    const unsigned int SAMPLES_PER_THREAD = 16;
+    numberOfThreads = effectiveThreads(rows, numberOfThreads);
+
+    std::cout << "   - " << name << ":" << std::endl;
+
+    for (unsigned int t = 0; t < numberOfThreads; t++) {
+        Range range = partitionRange(0, rows, numberOfThreads, t);
+
+        std::vector<const void*> addresses;
+        unsigned int count = range.end - range.start;
+        unsigned int step = count > SAMPLES_PER_THREAD ? count / SAMPLES_PER_THREAD : 1;
+        for (unsigned int i = range.start; i < range.end; i += step) {
+            addresses.push_back(rowAddress(i));
+        }
+
+        std::cout << "      - Thread " << t << " (rows " << range.start << "-" << range.end - 1
+                  << ", expected node " << nodeForThread(topology, t, numberOfThreads) << "): "
+                  << summarizePageNodes(queryPageNodes(addresses)) << std::endl;
+    }
+
+    if (topology.isSimulated) {
+        std::cout << "      - Simulated topology: pages stay on the real nodes listed above" << std::endl;
+    }
+}
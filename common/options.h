@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdlib> // Needed for atoi and atof
+#include <map> // Needed for the flag table
+#include <string> // Needed for string
+
+// Optional `--name` and `--name=value` flags shared by the labs.
+//
+// Flags may appear anywhere on the command line. `parseOptions` removes them from argv,
+// so every lab keeps reading its positional arguments from the same indices as before.
+class Options {
+public:
+    bool has(const std::string& name) const {
+        return flags.count(name) != 0;
+    }
+
+    std::string getString(const std::string& name, const std::string& defaultValue = "") const {
+        auto it = flags.find(name);
+        return it == flags.end() ? defaultValue : it->second;
+    }
+
+    int getInt(const std::string& name, int defaultValue = 0) const {
+        auto it = flags.find(name);
+        return it == flags.end() || it->second.empty() ? defaultValue : atoi(it->second.c_str());
+    }
+
+    double getDouble(const std::string& name, double defaultValue = 0) const {
+        auto it = flags.find(name);
+        return it == flags.end() || it->second.empty() ? defaultValue : atof(it->second.c_str());
+    }
+
+    void set(const std::string& name, const std::string& value) {
+        flags[name] = value;
+    }
+
+private:
+    std::map<std::string, std::string> flags;
+};
+
+inline Options parseOptions(int& argc, char* argv[]) {
+    Options options;
+    int positionalCount = 1; // argv[0] is the program name
+
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+
+        if (argument.size() > 2 && argument.compare(0, 2, "--") == 0) {
+            size_t equalsPosition = argument.find('=');
+            if (equalsPosition == std::string::npos) {
+                options.set(argument.substr(2), "");
+            } else {
+                options.set(argument.substr(2, equalsPosition - 2), argument.substr(equalsPosition + 1));
+            }
+        } else {
+            argv[positionalCount++] = argv[i];
+        }
+    }
+
+    argc = positionalCount;
+    return options;
+}
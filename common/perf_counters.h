@@ -0,0 +1,284 @@
+#pragma once
+
+#include <cerrno> // Needed for errno
+#include <cstdint> // Needed for uint64_t
+#include <cstring> // Needed for strerror
+#include <iostream> // Needed to print the counters
+#include <string> // Needed for string
+#include <vector> // Needed for the per-thread counters
+
+#ifdef __linux__
+#include <linux/perf_event.h> // Needed for perf_event_attr
+#include <sys/ioctl.h> // Needed to enable and disable the counters
+#include <sys/syscall.h> // Needed for SYS_perf_event_open
+#include <unistd.h> // Needed for syscall, read and close
+#endif
+
+#include "thread_pool.h"
+
+// Hardware performance counters of the timed runs (Linux perf_event), `--perf` in every lab.
+//
+// Every thread of the shared pool opens one counter group for itself: cycles, instructions,
+// last level cache misses and branch misses. Pool threads keep their index between regions,
+// so the counts of thread t are the work of part t of every parallel region. Only user space
+// is counted, which perf_event_paranoid <= 2 allows for the own process without privileges.
+//
+// When the counters cannot be opened (other platforms, containers without perf_event, VMs
+// without a virtual PMU) the runs are timed as usual and the reason is reported instead.
+
+struct HardwareCounts {
+    double cycles = 0;
+    double instructions = 0;
+    double cacheMisses = 0; // Last level cache
+    double branchMisses = 0;
+
+    double ipc() const {
+        return cycles > 0 ? instructions / cycles : 0;
+    }
+};
+
+struct CounterStats {
+    bool isEnabled = false; // --perf was given
+    std::string unavailableReason; // Empty when the counters were read
+    HardwareCounts total; // Per run, all threads together
+    std::vector<HardwareCounts> threads; // Per run, by thread index of the pool
+
+    bool isAvailable() const {
+        return isEnabled && unavailableReason.empty();
+    }
+};
+
+// Counter group of the thread that opens it
+class PerfCounterGroup {
+public:
+    PerfCounterGroup() = default;
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+    ~PerfCounterGroup() {
+        close();
+    }
+
+    // Returns an empty string on success, the reason otherwise
+    std::string open() {
+#ifdef __linux__
+        static const uint64_t EVENTS[EVENT_COUNT] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+        };
+
+        for (unsigned int i = 0; i < EVENT_COUNT; i++) {
+            perf_event_attr attributes;
+            memset(&attributes, 0, sizeof(attributes));
+            attributes.size = sizeof(attributes);
+            attributes.type = PERF_TYPE_HARDWARE;
+            attributes.config = EVENTS[i];
+            attributes.disabled = i == 0; // The whole group follows its leader
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            descriptors[i] = syscall(SYS_perf_event_open, &attributes, 0, -1, i == 0 ? -1 : descriptors[0], 0);
+            if (descriptors[i] < 0) {
+                std::string reason = std::string("perf_event_open: ") + strerror(errno);
+                if (errno == EACCES || errno == EPERM) {
+                    reason += ", see /proc/sys/kernel/perf_event_paranoid";
+                } else if (errno == ENOENT || errno == EOPNOTSUPP) {
+                    reason += ", no hardware counters here";
+                }
+                close();
+                return reason;
+            }
+        }
+        return "";
+#else
+        return "hardware counters are only supported on Linux";
+#endif
+    }
+
+#ifdef __linux__
+    void reset() {
+        control(PERF_EVENT_IOC_RESET);
+    }
+
+    void enable() {
+        control(PERF_EVENT_IOC_ENABLE);
+    }
+
+    void disable() {
+        control(PERF_EVENT_IOC_DISABLE);
+    }
+#else
+    void reset() {}
+    void enable() {}
+    void disable() {}
+#endif
+
+    // Counts so far, scaled up when the kernel had to multiplex the counters
+    HardwareCounts read() const {
+        HardwareCounts counts;
+
+#ifdef __linux__
+        struct {
+            uint64_t count;
+            uint64_t timeEnabled;
+            uint64_t timeRunning;
+            uint64_t values[EVENT_COUNT];
+        } data;
+
+        if (descriptors[0] < 0 || ::read(descriptors[0], &data, sizeof(data)) != sizeof(data) || data.timeRunning == 0) {
+            return counts;
+        }
+
+        double scale = double(data.timeEnabled) / data.timeRunning;
+        counts.cycles = data.values[0] * scale;
+        counts.instructions = data.values[1] * scale;
+        counts.cacheMisses = data.values[2] * scale;
+        counts.branchMisses = data.values[3] * scale;
+#endif
+
+        return counts;
+    }
+
+private:
+    static constexpr unsigned int EVENT_COUNT = 4;
+
+    int descriptors[EVENT_COUNT] = { -1, -1, -1, -1 };
+
+#ifdef __linux__
+    void control(unsigned long request) {
+        if (descriptors[0] >= 0) {
+            ioctl(descriptors[0], request, PERF_IOC_FLAG_GROUP);
+        }
+    }
+#endif
+
+    void close() {
+        for (int& descriptor : descriptors) {
+#ifdef __linux__
+            if (descriptor >= 0) {
+                ::close(descriptor);
+            }
+#endif
+            descriptor = -1;
+        }
+    }
+};
+
+// One counter group on every thread of the shared pool as it is now, so the pool has to be
+// started with its final number of threads before the counters are opened
+class ThreadCounters {
+public:
+    ThreadCounters() : groups(ThreadPool::shared(1).maxThreads()) {
+        std::vector<std::string> reasons(groups.size());
+
+        parallelRun(groups.size(), [&](unsigned int threadIndex) {
+            reasons[threadIndex] = groups[threadIndex].open();
+        });
+
+        for (const std::string& reason : reasons) {
+            if (!reason.empty()) {
+                unavailableReason = reason;
+                break;
+            }
+        }
+    }
+
+    // Start counting from zero, the counters stay disabled until `enable`
+    void reset() {
+        for (PerfCounterGroup& group : groups) {
+            group.reset();
+        }
+    }
+
+    void enable() {
+        for (PerfCounterGroup& group : groups) {
+            group.enable();
+        }
+    }
+
+    void disable() {
+        for (PerfCounterGroup& group : groups) {
+            group.disable();
+        }
+    }
+
+    // Counts since `reset` divided by `runs`
+    CounterStats read(unsigned int runs) const {
+        CounterStats stats;
+        stats.isEnabled = true;
+        stats.unavailableReason = unavailableReason;
+        if (!unavailableReason.empty() || runs == 0) {
+            return stats;
+        }
+
+        for (const PerfCounterGroup& group : groups) {
+            HardwareCounts counts = group.read();
+            counts.cycles /= runs;
+            counts.instructions /= runs;
+            counts.cacheMisses /= runs;
+            counts.branchMisses /= runs;
+
+            stats.total.cycles += counts.cycles;
+            stats.total.instructions += counts.instructions;
+            stats.total.cacheMisses += counts.cacheMisses;
+            stats.total.branchMisses += counts.branchMisses;
+            stats.threads.push_back(counts);
+        }
+
+        return stats;
+    }
+
+private:
+    std::vector<PerfCounterGroup> groups;
+    std::string unavailableReason;
+};
+
+// "   - Counters: 12.3M cycles, 24.6M instructions (IPC 2), 0.3M LLC misses, 0.01M branch misses per run",
+// then one line per thread that did any work when there is more than one
+inline void printCounterStats(const CounterStats& stats) {
+    if (!stats.isEnabled) {
+        return;
+    }
+
+    if (!stats.isAvailable()) {
+        std::cout << "   - Counters: unavailable (" << stats.unavailableReason << ")" << std::endl;
+        return;
+    }
+
+    const HardwareCounts& total = stats.total;
+    std::cout << "   - Counters: " << total.cycles / 1e6 << "M cycles, " << total.instructions / 1e6 << "M instructions (IPC "
+              << total.ipc() << "), " << total.cacheMisses / 1e6 << "M LLC misses, " << total.branchMisses / 1e6 << "M branch misses per run" << std::endl;
+
+    unsigned int activeThreads = 0;
+    for (const HardwareCounts& counts : stats.threads) {
+        activeThreads += counts.instructions > 0 ? 1 : 0;
+    }
+    if (activeThreads <= 1) {
+        return;
+    }
+
+    for (unsigned int t = 0; t < stats.threads.size(); t++) {
+        const HardwareCounts& counts = stats.threads[t];
+        if (counts.instructions > 0) {
+            std::cout << "      - Thread " << t << ": " << counts.cycles / 1e6 << "M cycles, IPC " << counts.ipc() << ", "
+                      << counts.cacheMisses / 1e6 << "M LLC misses, " << counts.branchMisses / 1e6 << "M branch misses" << std::endl;
+        }
+    }
+}
+
+// "   - Parallel counters: IPC 1.8, 0.3M LLC misses, 0.01M branch misses per run" for the summaries
+inline void printCounterSummary(
+    const std::string& label,
+    const CounterStats& stats,
+    const std::string& indent = "   "
+) {
+    if (!stats.isAvailable()) {
+        return;
+    }
+
+    std::cout << indent << "- " << label << ": IPC " << stats.total.ipc() << ", " << stats.total.cacheMisses / 1e6 << "M LLC misses, "
+              << stats.total.branchMisses / 1e6 << "M branch misses per run" << std::endl;
+}
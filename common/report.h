@@ -0,0 +1,354 @@
+#pragma once
+
+#include <cstdio> // Needed for snprintf
+#include <cstdlib> // Needed for exit
+#include <fstream> // Needed to read /proc/cpuinfo and to write the report file
+#include <iostream> // Needed for cout and cerr
+#include <limits> // Needed for the largest unsigned int
+#include <sstream> // Needed to split the sweep lists
+#include <string> // Needed for string
+#include <thread> // Needed for hardware_concurrency
+#include <vector> // Needed for the records
+
+#include "benchmark.h"
+#include "options.h"
+
+// Machine-readable results and sweeps shared by the labs.
+//
+// `--format=json` or `--format=csv` collects one record per timed algorithm and writes them,
+// with the CPU model and the compiler, when the program ends. The report goes to `--output=<file>`,
+// or to stdout, in which case the usual human-readable lines move to stderr so stdout stays parseable.
+//
+// `--threads=<list>` and `--sizes=<list>` (for example `1-8` or `256,512,1024`) run the benchmark
+// once per size and thread count in one process, which gives strong-scaling curves (one size,
+// every thread count) and weak-scaling curves (size growing with the thread count) from one report.
+
+#ifndef BENCHMARK_COMPILE_FLAGS
+#define BENCHMARK_COMPILE_FLAGS "" // Set by the build system when it knows the flags
+#endif
+
+struct BenchmarkRecord {
+    std::string algorithm;
+    std::string size;
+    unsigned int threads;
+    TimingStats stats;
+    double speedup; // Against the sequential run of the same size, 0 when there is none
+    double efficiency;
+};
+
+struct ReportSettings {
+    std::string format; // Empty for the human-readable output only
+    std::string outputPath; // Empty for stdout
+    std::vector<BenchmarkRecord> records;
+    std::streambuf* reportBuffer = nullptr; // The real stdout when cout was moved to stderr
+};
+
+inline ReportSettings& reportSettings() {
+    static ReportSettings settings;
+    return settings;
+}
+
+inline bool isReportEnabled() {
+    return !reportSettings().format.empty();
+}
+
+// Usage line of the shared flags
+inline const char* reportUsage() {
+    return "--format=<json|csv> --output=<file> --threads=<list> --sizes=<list>";
+}
+
+inline void configureReport(const Options& options) {
+    ReportSettings& settings = reportSettings();
+    settings.format = options.getString("format");
+    settings.outputPath = options.getString("output");
+
+    if (settings.format != "" && settings.format != "json" && settings.format != "csv") {
+        std::cerr << "Unknown --format=" << settings.format << ", expected json or csv" << std::endl;
+        settings.format = "";
+    }
+
+    if (isReportEnabled() && settings.outputPath.empty()) {
+        settings.reportBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+    }
+}
+
+// Positive number of a --sizes or --threads list, 0 when `text` is not one
+inline unsigned int parsePositive(const std::string& text) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+        return 0;
+    }
+
+    try {
+        unsigned long value = std::stoul(text);
+        return value <= std::numeric_limits<unsigned int>::max() ? (unsigned int)value : 0;
+    } catch (const std::out_of_range&) {
+        return 0;
+    }
+}
+
+// "1-4,8" -> 1, 2, 3, 4, 8. Returns `defaultValue` alone when the list is empty.
+// An element that is not a positive number or an increasing range ends the program with a usage message.
+inline std::vector<unsigned int> parseUnsignedList(
+    const std::string& name,
+    const std::string& list,
+    unsigned int defaultValue
+) {
+    std::vector<unsigned int> values;
+    std::stringstream stream(list);
+    std::string part;
+
+    while (std::getline(stream, part, ',')) {
+        if (part.empty()) {
+            continue;
+        }
+
+        size_t dash = part.find('-');
+        unsigned int first = parsePositive(part.substr(0, dash));
+        unsigned int last = dash == std::string::npos ? first : parsePositive(part.substr(dash + 1));
+
+        if (first == 0 || last == 0 || first > last) {
+            std::cerr << "Invalid --" << name << "=" << list << " at \"" << part << "\", expected positive numbers or ranges such as 1-4,8" << std::endl;
+            std::exit(1);
+        }
+
+        // Stops at `last` itself, so a range ending at the largest unsigned int does not wrap around
+        for (unsigned int value = first;; value++) {
+            values.push_back(value);
+            if (value == last) {
+                break;
+            }
+        }
+    }
+
+    if (values.empty()) {
+        values.push_back(defaultValue);
+    }
+
+    return values;
+}
+
+// Thread counts of the sweep, the positional thread count when --threads is not given
+inline std::vector<unsigned int> sweepThreads(
+    const Options& options,
+    unsigned int threads
+) {
+    return parseUnsignedList("threads", options.getString("threads"), threads);
+}
+
+// Sizes of the sweep, the positional size when --sizes is not given
+inline std::vector<unsigned int> sweepSizes(
+    const Options& options,
+    unsigned int size
+) {
+    return parseUnsignedList("sizes", options.getString("sizes"), size);
+}
+
+inline void recordBenchmark(
+    const std::string& algorithm,
+    const std::string& size,
+    unsigned int threads,
+    const TimingStats& stats,
+    double speedup = 0,
+    double efficiency = 0
+) {
+    if (isReportEnabled()) {
+        reportSettings().records.push_back({ algorithm, size, threads, stats, speedup, efficiency });
+    }
+}
+
+inline std::string cpuModel() {
+    std::ifstream file("/proc/cpuinfo");
+    std::string line;
+
+    while (std::getline(file, line)) {
+        if (line.compare(0, 10, "model name") == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos && colon + 2 <= line.size()) {
+                return line.substr(colon + 2);
+            }
+        }
+    }
+
+    return "unknown";
+}
+
+inline std::string compilerVersion() {
+#if defined(__clang__)
+    return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+    return std::string("gcc ") + __VERSION__;
+#else
+    return "unknown";
+#endif
+}
+
+// Flags passed by the build, or what the preprocessor can tell about them
+inline std::string compileFlags() {
+    std::string flags = BENCHMARK_COMPILE_FLAGS;
+    if (!flags.empty()) {
+        return flags;
+    }
+
+#ifdef __OPTIMIZE__
+    flags = "optimized";
+#else
+    flags = "-O0";
+#endif
+#ifdef __AVX512F__
+    flags += " avx512f";
+#elif defined(__AVX2__)
+    flags += " avx2";
+#endif
+    return flags;
+}
+
+// Quotes, backslashes and control characters escaped, as a JSON string requires
+inline std::string escapeJson(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else if (c == '\t') {
+            escaped += "\\t";
+        } else if (c == '\r') {
+            escaped += "\\r";
+        } else if ((unsigned char)c < 0x20) {
+            char code[7];
+            std::snprintf(code, sizeof(code), "\\u%04x", (unsigned char)c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// CSV fields are quoted when they contain a separator or a quote
+inline std::string escapeCsv(const std::string& text) {
+    if (text.find_first_of(",\"") == std::string::npos) {
+        return text;
+    }
+
+    std::string escaped = "\"";
+    for (char c : text) {
+        escaped += c;
+        if (c == '"') {
+            escaped += '"';
+        }
+    }
+    return escaped + "\"";
+}
+
+// {"cycles": ..., "threads": [...]} per run, or null when --perf was not given or the counters were unavailable
+inline void writeJsonCounters(std::ostream& out, const CounterStats& counters) {
+    if (!counters.isAvailable()) {
+        out << "null";
+        return;
+    }
+
+    auto writeCounts = [&](const HardwareCounts& counts) {
+        out << "\"cycles\": " << counts.cycles << ", \"instructions\": " << counts.instructions << ", \"ipc\": " << counts.ipc()
+            << ", \"llcMisses\": " << counts.cacheMisses << ", \"branchMisses\": " << counts.branchMisses;
+    };
+
+    out << "{";
+    writeCounts(counters.total);
+    out << ", \"threads\": [";
+    for (size_t t = 0; t < counters.threads.size(); t++) {
+        out << (t > 0 ? ", {" : "{");
+        writeCounts(counters.threads[t]);
+        out << "}";
+    }
+    out << "]}";
+}
+
+inline void writeJsonReport(std::ostream& out, const std::string& lab) {
+    const ReportSettings& settings = reportSettings();
+    const BenchmarkSettings& benchmark = benchmarkSettings();
+
+    out << "{" << std::endl;
+    out << "  \"lab\": \"" << escapeJson(lab) << "\"," << std::endl;
+    out << "  \"environment\": {"
+        << "\"cpu\": \"" << escapeJson(cpuModel()) << "\", "
+        << "\"hardwareThreads\": " << std::thread::hardware_concurrency() << ", "
+        << "\"compiler\": \"" << escapeJson(compilerVersion()) << "\", "
+        << "\"flags\": \"" << escapeJson(compileFlags()) << "\"}," << std::endl;
+    out << "  \"settings\": {\"warmupRuns\": " << benchmark.warmupRuns << ", \"repetitions\": " << benchmark.repetitions << "}," << std::endl;
+    out << "  \"results\": [" << std::endl;
+
+    for (size_t i = 0; i < settings.records.size(); i++) {
+        const BenchmarkRecord& record = settings.records[i];
+        out << "    {\"algorithm\": \"" << escapeJson(record.algorithm) << "\", "
+            << "\"size\": \"" << escapeJson(record.size) << "\", "
+            << "\"threads\": " << record.threads << ", "
+            << "\"medianMs\": " << record.stats.median << ", "
+            << "\"meanMs\": " << record.stats.mean << ", "
+            << "\"p95Ms\": " << record.stats.p95 << ", "
+            << "\"stddevMs\": " << record.stats.stddev << ", "
+            << "\"minMs\": " << record.stats.min << ", "
+            << "\"runs\": " << record.stats.runs << ", "
+            << "\"speedup\": " << record.speedup << ", "
+            << "\"efficiency\": " << record.efficiency << ", "
+            << "\"counters\": ";
+        writeJsonCounters(out, record.stats.counters);
+        out << "}" << (i + 1 < settings.records.size() ? "," : "") << std::endl;
+    }
+
+    out << "  ]" << std::endl;
+    out << "}" << std::endl;
+}
+
+inline void writeCsvReport(std::ostream& out, const std::string& lab) {
+    std::string environment = escapeCsv(lab) + "," + escapeCsv(cpuModel()) + "," + escapeCsv(compilerVersion()) + "," + escapeCsv(compileFlags());
+
+    // Counters are totals of all threads per run, empty when unavailable
+    out << "lab,cpu,compiler,flags,algorithm,size,threads,median_ms,mean_ms,p95_ms,stddev_ms,min_ms,runs,speedup,efficiency,"
+        << "cycles,instructions,ipc,llc_misses,branch_misses" << std::endl;
+    for (const BenchmarkRecord& record : reportSettings().records) {
+        out << environment << "," << escapeCsv(record.algorithm) << "," << escapeCsv(record.size) << "," << record.threads << ","
+            << record.stats.median << "," << record.stats.mean << "," << record.stats.p95 << "," << record.stats.stddev << ","
+            << record.stats.min << "," << record.stats.runs << "," << record.speedup << "," << record.efficiency << ",";
+
+        const CounterStats& counters = record.stats.counters;
+        if (counters.isAvailable()) {
+            out << counters.total.cycles << "," << counters.total.instructions << "," << counters.total.ipc() << ","
+                << counters.total.cacheMisses << "," << counters.total.branchMisses << std::endl;
+        } else {
+            out << ",,,," << std::endl;
+        }
+    }
+}
+
+// Write every record collected so far, once, at the end of main
+inline void writeBenchmarkReport(const std::string& lab) {
+    ReportSettings& settings = reportSettings();
+    if (!isReportEnabled()) {
+        return;
+    }
+
+    std::ofstream file;
+    std::ostream out(settings.reportBuffer != nullptr ? settings.reportBuffer : std::cout.rdbuf());
+    if (!settings.outputPath.empty()) {
+        file.open(settings.outputPath);
+        if (!file) {
+            std::cerr << "Cannot write the report to " << settings.outputPath << std::endl;
+            return;
+        }
+        out.rdbuf(file.rdbuf());
+    }
+
+    if (settings.format == "json") {
+        writeJsonReport(out, lab);
+    } else {
+        writeCsvReport(out, lab);
+    }
+
+    out.flush();
+    if (settings.reportBuffer != nullptr) {
+        std::cout.rdbuf(settings.reportBuffer);
+        settings.reportBuffer = nullptr;
+    }
+}
@@ -0,0 +1,328 @@
+#pragma once
+
+#include <atomic> // Needed for the dispatch counters
+#include <chrono> // Needed for the overhead measurement
+#include <condition_variable> // Needed to park idle workers
+#include <memory> // Needed for unique_ptr
+#include <mutex> // Needed for mutex
+#include <thread> // Needed for multithreading
+#include <vector> // Needed for the list of workers
+
+// Persistent worker pool shared by all labs.
+//
+// Creating and joining `std::thread`s costs tens of microseconds per thread, which adds up
+// when a parallel region runs once per iteration (Jacobi) or once per vertex (Floyd, Dijkstra, Prim).
+// The pool starts its workers once; every parallel region after that only wakes them up.
+//
+// The thread that calls `run` always takes part as thread 0, so a region with k threads
+// uses k - 1 workers from the pool.
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int numberOfWorkers) {
+        // Spinning only pays off when every thread has a core of its own
+        spinCount = numberOfWorkers < std::thread::hardware_concurrency() ? SPIN_COUNT : 0;
+
+        for (unsigned int i = 0; i < numberOfWorkers; i++) {
+            workers.emplace_back([this, i]() {
+                workerLoop(i + 1);
+            });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            isStopping.store(true, std::memory_order_relaxed);
+            generation.fetch_add(1, std::memory_order_release);
+        }
+        wakeCondition.notify_all();
+
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // Maximum number of threads a region can use, including the calling thread
+    unsigned int maxThreads() const {
+        return workers.size() + 1;
+    }
+
+    // Run `task(threadIndex)` for every threadIndex in [0, numberOfThreads) and wait for all of them.
+    // `numberOfThreads` is clamped to `maxThreads()`. Calls from inside a task run sequentially.
+    template <typename Task>
+    void run(unsigned int numberOfThreads, Task& task) {
+        if (numberOfThreads > maxThreads()) {
+            numberOfThreads = maxThreads();
+        }
+
+        if (numberOfThreads <= 1 || isInsideRegion()) {
+            for (unsigned int i = 0; i < numberOfThreads; i++) {
+                task(i);
+            }
+            return;
+        }
+
+        std::lock_guard<std::mutex> dispatchLock(dispatchMutex);
+
+        jobInvoke = [](void* context, unsigned int threadIndex) {
+            (*static_cast<Task*>(context))(threadIndex);
+        };
+        jobContext = &task;
+        jobThreads = numberOfThreads;
+
+        // Every worker acknowledges every job, even when it has no part in it,
+        // so no worker can fall behind by more than one job
+        pendingWorkers.store(workers.size(), std::memory_order_relaxed);
+
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            generation.fetch_add(1, std::memory_order_release);
+        }
+        wakeCondition.notify_all();
+
+        isInsideRegion() = true;
+        task(0);
+        isInsideRegion() = false;
+
+        for (unsigned int spin = 0; pendingWorkers.load(std::memory_order_acquire) != 0; spin++) {
+            if (spin < spinCount) {
+                cpuRelax();
+            } else {
+                // More threads than cores: let the workers we are waiting for run
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Pool shared by the whole program, grown on demand to `numberOfThreads` threads.
+    // Must not be called while a region is running on it.
+    static ThreadPool& shared(unsigned int numberOfThreads) {
+        static std::unique_ptr<ThreadPool> pool;
+
+        // Regions nested inside a running region execute sequentially, so the pool is never replaced under them
+        if (!pool || (pool->maxThreads() < numberOfThreads && !isInsideRegion())) {
+            pool.reset();
+            pool.reset(new ThreadPool(numberOfThreads > 0 ? numberOfThreads - 1 : 0));
+        }
+
+        return *pool;
+    }
+
+private:
+    // Number of polls before an idle worker goes to sleep, so back-to-back regions skip the futex wake-up
+    static constexpr unsigned int SPIN_COUNT = 1 << 11;
+
+    std::vector<std::thread> workers;
+    unsigned int spinCount;
+
+    std::mutex dispatchMutex;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    std::atomic<unsigned long long> generation{ 0 };
+    std::atomic<unsigned int> pendingWorkers{ 0 };
+    std::atomic<bool> isStopping{ false };
+
+    void (*jobInvoke)(void*, unsigned int) = nullptr;
+    void* jobContext = nullptr;
+    unsigned int jobThreads = 0;
+
+    // True on workers and on a caller while it runs its own part of a region
+    static bool& isInsideRegion() {
+        static thread_local bool isInside = false;
+        return isInside;
+    }
+
+    void workerLoop(unsigned int threadIndex) {
+        isInsideRegion() = true;
+        unsigned long long seenGeneration = 0;
+
+        while (true) {
+            for (unsigned int spin = 0; spin < spinCount && generation.load(std::memory_order_acquire) == seenGeneration; spin++) {
+                cpuRelax();
+            }
+
+            if (generation.load(std::memory_order_acquire) == seenGeneration) {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wakeCondition.wait(lock, [&]() {
+                    return generation.load(std::memory_order_acquire) != seenGeneration;
+                });
+            }
+
+            seenGeneration = generation.load(std::memory_order_acquire);
+
+            if (isStopping.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            if (threadIndex < jobThreads) {
+                jobInvoke(jobContext, threadIndex);
+            }
+
+            pendingWorkers.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+};
+
+// Run `task(threadIndex)` on `numberOfThreads` threads of the shared pool
+template <typename Task>
+void parallelRun(
+    unsigned int numberOfThreads,
+    Task task
+) {
+    ThreadPool::shared(numberOfThreads).run(numberOfThreads, task);
+}
+
+// Barrier for the threads of one `parallelRun` region, so a region can go through many phases
+// (the iterations of a solver) without returning to the caller between them.
+// Every thread of the region has to call `wait` the same number of times. The region must not be
+// nested in another one: nested regions run their threads one after the other and would never meet.
+class SpinBarrier {
+public:
+    explicit SpinBarrier(unsigned int numberOfThreads)
+        : numberOfThreads(numberOfThreads) {
+        // Spinning only pays off when every thread has a core of its own
+        spinCount = numberOfThreads <= std::thread::hardware_concurrency() ? SPIN_COUNT : 0;
+    }
+
+    SpinBarrier(const SpinBarrier&) = delete;
+    SpinBarrier& operator=(const SpinBarrier&) = delete;
+
+    // Wait until all `numberOfThreads` threads have arrived. Writes made before `wait`
+    // are visible to every thread after it.
+    void wait() {
+        unsigned int arrivalGeneration = generation.load(std::memory_order_acquire);
+
+        if (arrivedThreads.fetch_add(1, std::memory_order_acq_rel) + 1 == numberOfThreads) {
+            // Reset before releasing, so a thread that is already on its way to the next wait counts from 0
+            arrivedThreads.store(0, std::memory_order_relaxed);
+            generation.fetch_add(1, std::memory_order_acq_rel);
+            return;
+        }
+
+        for (unsigned int spin = 0; generation.load(std::memory_order_acquire) == arrivalGeneration; spin++) {
+            if (spin < spinCount) {
+                cpuRelax();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+private:
+    static constexpr unsigned int SPIN_COUNT = 1 << 14;
+
+    const unsigned int numberOfThreads;
+    unsigned int spinCount;
+
+    // Separate cache lines: every arrival writes the counter, the waiting threads poll the generation
+    alignas(64) std::atomic<unsigned int> arrivedThreads{ 0 };
+    alignas(64) std::atomic<unsigned int> generation{ 0 };
+};
+
+struct Range {
+    unsigned int start;
+    unsigned int end; // Exclusive
+};
+
+// Part `threadIndex` of [begin, end) split into `numberOfThreads` contiguous parts.
+// The first `(end - begin) % numberOfThreads` parts take 1 more element,
+// the same distribution every lab used with its own thread arrays.
+inline Range partitionRange(
+    unsigned int begin,
+    unsigned int end,
+    unsigned int numberOfThreads,
+    unsigned int threadIndex
+) {
+    unsigned int total = end > begin ? end - begin : 0;
+    unsigned int elementsPerThread = total / numberOfThreads;
+    unsigned int remainingElements = total % numberOfThreads;
+
+    unsigned int start = begin + threadIndex * elementsPerThread + (threadIndex < remainingElements ? threadIndex : remainingElements);
+    unsigned int stop = start + elementsPerThread + (threadIndex < remainingElements ? 1 : 0);
+
+    return { start, stop };
+}
+
+// Number of threads parallelFor really uses for `total` elements
+inline unsigned int effectiveThreads(
+    unsigned int total,
+    unsigned int numberOfThreads
+) {
+    // No need to use more threads than elements
+    return numberOfThreads > total ? total : numberOfThreads;
+}
+
+// Run `body(start, end)` for every part of [begin, end) split by `partitionRange` on the shared pool
+template <typename Body>
+void parallelFor(
+    unsigned int begin,
+    unsigned int end,
+    unsigned int numberOfThreads,
+    Body body
+) {
+    unsigned int total = end > begin ? end - begin : 0;
+    numberOfThreads = effectiveThreads(total, numberOfThreads);
+
+    if (numberOfThreads <= 1) {
+        if (total > 0) {
+            body(begin, end);
+        }
+        return;
+    }
+
+    parallelRun(numberOfThreads, [&](unsigned int threadIndex) {
+        Range range = partitionRange(begin, end, numberOfThreads, threadIndex);
+        body(range.start, range.end);
+    });
+}
+
+// Average cost of one empty parallel region, in microseconds
+inline double measurePoolDispatchOverhead(
+    unsigned int numberOfThreads,
+    unsigned int iterations = 1000
+) {
+    ThreadPool& pool = ThreadPool::shared(numberOfThreads);
+    auto task = [](unsigned int) {};
+
+    pool.run(numberOfThreads, task); // Wake the workers once before timing
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < iterations; i++) {
+        pool.run(numberOfThreads, task);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+}
+
+// Average cost of spawning and joining `numberOfThreads` empty threads, in microseconds
+inline double measureThreadSpawnOverhead(
+    unsigned int numberOfThreads,
+    unsigned int iterations = 100
+) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < iterations; i++) {
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < numberOfThreads; t++) {
+            threads.emplace_back([]() {});
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+
+    return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+}
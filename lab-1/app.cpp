@@ -3,6 +3,28 @@
 #include <cstdlib> // Needed for rand and srand
 #include <thread> // Needed for multithreading
 #include <functional>  // Needed to pass functions as arguments
+#include <chrono> // Needed for time measurements
+#include <cstring> // Needed for memset
+#include <new> // Needed for bad_alloc
+#include <stdexcept> // Needed for invalid_argument
+#include <vector> // Needed for the list of available SIMD kernels
+#include <cstdint> // Needed for uintptr_t
+#include <unistd.h> // Needed for sysconf
+
+#include <random> // Needed for per-thread random generators
+
+#include "../common/thread_pool.h" // Shared worker pool and parallelFor
+#include "../common/numa.h" // First-touch placement and thread pinning
+#include "../common/options.h" // Optional --flags
+#include "../common/benchmark.h" // Warm-up, repetitions and timing statistics
+#include "../common/report.h" // JSON/CSV report and size/thread sweeps
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // SSE2, AVX2 and AVX-512 intrinsics
+#define HAS_X86_SIMD 1
+#else
+#define HAS_X86_SIMD 0
+#endif
 
 using namespace std;
 
@@ -34,6 +56,171 @@ int** generateMatrix(
     return matrix;
 }
 
+// Same as generateMatrix, but every row is allocated and written by the thread that
+// `parallelFor` later gives it to, so its pages land on that thread's NUMA node
+int** generateMatrixParallel(
+    unsigned int n,
+    unsigned int m,
+    unsigned int numberOfThreads
+) {
+    int** matrix = new int*[n];
+    unsigned int baseSeed = rand(); // Still driven by srand in main
+
+    parallelFor(0, n, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        // rand() is not thread-safe, every part gets its own generator
+        minstd_rand generator(baseSeed + startRow);
+
+        for (unsigned int i = startRow; i < endRow; i++) {
+            matrix[i] = new int[m];
+
+            for (unsigned int j = 0; j < m; j++) {
+                matrix[i][j] = generator() % 100;
+            }
+        }
+    });
+
+    return matrix;
+}
+
+void freeMatrix(int** matrix, unsigned int n) {
+    for (unsigned int i = 0; i < n; i++) {
+        delete[] matrix[i];
+    }
+    delete[] matrix;
+}
+
+// Every row of a contiguous matrix starts on its own cache line
+constexpr size_t CACHE_LINE_SIZE = 64;
+constexpr size_t INTS_PER_CACHE_LINE = CACHE_LINE_SIZE / sizeof(int);
+
+// Non-owning view over a row-major matrix.
+// `stride` is the distance in elements between the starts of two consecutive rows,
+// so a view can also describe a sub-block of a bigger matrix.
+struct MatrixView {
+    int* data;
+    unsigned int rows;
+    unsigned int cols;
+    size_t stride;
+
+    int* row(unsigned int i) const {
+        return data + i * stride;
+    }
+
+    int& operator()(unsigned int i, unsigned int j) const {
+        return data[i * stride + j];
+    }
+
+    // View over `numRows` x `numCols` elements starting at (startRow, startCol)
+    MatrixView block(
+        unsigned int startRow,
+        unsigned int startCol,
+        unsigned int numRows,
+        unsigned int numCols
+    ) const {
+        return { row(startRow) + startCol, numRows, numCols, stride };
+    }
+
+    MatrixView rowRange(unsigned int startRow, unsigned int endRow) const {
+        return block(startRow, 0, endRow - startRow, cols);
+    }
+};
+
+// Row-major matrix stored in a single 64-byte aligned allocation.
+// Rows are padded to a whole number of cache lines, the padding is zeroed.
+// With `firstTouchThreads` > 1 the rows are zeroed by the pool threads with the `parallelFor`
+// partition, so on NUMA machines each row lives on the node of the thread that will process it.
+class Matrix {
+public:
+    Matrix() : data(nullptr), rows(0), cols(0), stride(0) {}
+
+    Matrix(
+        unsigned int rows,
+        unsigned int cols,
+        unsigned int firstTouchThreads = 1
+    ) : rows(rows), cols(cols) {
+        stride = (cols + INTS_PER_CACHE_LINE - 1) / INTS_PER_CACHE_LINE * INTS_PER_CACHE_LINE;
+        size_t bytes = sizeInBytes();
+        data = bytes == 0 ? nullptr : static_cast<int*>(aligned_alloc(CACHE_LINE_SIZE, bytes));
+        if (bytes != 0 && data == nullptr) {
+            throw bad_alloc();
+        }
+        if (firstTouchThreads > 1) {
+            parallelFor(0, rows, firstTouchThreads, [&](unsigned int startRow, unsigned int endRow) {
+                memset(data + startRow * stride, 0, size_t(endRow - startRow) * stride * sizeof(int));
+            });
+        } else if (stride != cols) {
+            for (unsigned int i = 0; i < rows; i++) {
+                memset(data + i * stride + cols, 0, (stride - cols) * sizeof(int));
+            }
+        }
+    }
+
+    Matrix(const Matrix&) = delete;
+    Matrix& operator=(const Matrix&) = delete;
+
+    Matrix(Matrix&& other) noexcept
+        : data(other.data), rows(other.rows), cols(other.cols), stride(other.stride) {
+        other.data = nullptr;
+    }
+
+    Matrix& operator=(Matrix&& other) noexcept {
+        if (this != &other) {
+            free(data);
+            data = other.data;
+            rows = other.rows;
+            cols = other.cols;
+            stride = other.stride;
+            other.data = nullptr;
+        }
+        return *this;
+    }
+
+    ~Matrix() {
+        free(data);
+    }
+
+    MatrixView view() const {
+        return { data, rows, cols, stride };
+    }
+
+    operator MatrixView() const {
+        return view();
+    }
+
+    int* row(unsigned int i) const {
+        return data + i * stride;
+    }
+
+    unsigned int numRows() const { return rows; }
+    unsigned int numCols() const { return cols; }
+    size_t rowStride() const { return stride; }
+    size_t sizeInBytes() const { return size_t(rows) * stride * sizeof(int); }
+
+private:
+    int* data;
+    unsigned int rows;
+    unsigned int cols;
+    size_t stride;
+};
+
+// Copy an `int**` matrix into the contiguous layout, so both layouts hold the same values
+Matrix toContiguousMatrix(
+    int** matrix,
+    unsigned int n,
+    unsigned int m,
+    unsigned int numberOfThreads = 1
+) {
+    Matrix result(n, m, numberOfThreads);
+
+    parallelFor(0, n, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            memcpy(result.row(i), matrix[i], m * sizeof(int));
+        }
+    });
+
+    return result;
+}
+
 int* sumVectors(
     int* vector1,
     int* vector2,
@@ -62,6 +249,31 @@ int* subtractVectors(
     return result;
 }
 
+// Row operations for the contiguous layout write into a row that already exists
+void sumVectorsInto(
+    const int* vector1,
+    const int* vector2,
+    int* result,
+    unsigned int n
+) {
+    for (unsigned int i = 0; i < n; i++) {
+        result[i] = vector1[i] + vector2[i];
+    }
+}
+
+void subtractVectorsInto(
+    const int* vector1,
+    const int* vector2,
+    int* result,
+    unsigned int n
+) {
+    for (unsigned int i = 0; i < n; i++) {
+        result[i] = vector1[i] - vector2[i];
+    }
+}
+
+using RowOperation = function<void(const int*, const int*, int*, unsigned int)>;
+
 int** computeMatricesSequential(
     int** matrix1,
     int** matrix2,
@@ -86,42 +298,675 @@ int** computeMatricesParallel(
     unsigned int m,
     unsigned int numberOfThreads
 ) {
-    // No need to use more threads than rows
-    if (numberOfThreads > n) {
-        numberOfThreads = n;
+    int** result = new int*[n];
+
+    // Rows are split between the threads of the shared pool,
+    // the first `n % numberOfThreads` threads take 1 more row to distribute the remainder
+    parallelFor(0, n, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            result[i] = operation(matrix1[i], matrix2[i], m);
+        }
+    });
+
+    return result;
+}
+
+void checkSameShape(
+    const MatrixView& matrix1,
+    const MatrixView& matrix2
+) {
+    if (matrix1.rows != matrix2.rows || matrix1.cols != matrix2.cols) {
+        throw invalid_argument("Matrices must have the same dimensions");
     }
+}
 
-    int** result = new int*[n];
+// Writes `operation(matrix1, matrix2)` into `result`, which may alias `matrix1` or `matrix2`
+void computeMatricesSequential(
+    const MatrixView& matrix1,
+    const MatrixView& matrix2,
+    const MatrixView& result,
+    RowOperation operation
+) {
+    checkSameShape(matrix1, matrix2);
+    checkSameShape(matrix1, result);
 
-    unsigned int rowsPerThread = n / numberOfThreads;
-    unsigned int remainingRows = n % numberOfThreads; // This will be distributed among the first threads
+    for (unsigned int i = 0; i < matrix1.rows; i++) {
+        operation(matrix1.row(i), matrix2.row(i), result.row(i), matrix1.cols);
+    }
+}
 
-    thread* threads = new thread[numberOfThreads];
+void computeMatricesParallel(
+    const MatrixView& matrix1,
+    const MatrixView& matrix2,
+    const MatrixView& result,
+    RowOperation operation,
+    unsigned int numberOfThreads
+) {
+    checkSameShape(matrix1, matrix2);
+    checkSameShape(matrix1, result);
 
-    unsigned int currentRow = 0;
+    unsigned int m = matrix1.cols;
 
-    for (unsigned int threadIndex = 0; threadIndex < numberOfThreads; threadIndex++) {
-        // The first `remainingRows` threads will take 1 more row to distribute the remainder
-        bool shouldTakeRemainder = threadIndex < remainingRows;
+    parallelFor(0, matrix1.rows, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            operation(matrix1.row(i), matrix2.row(i), result.row(i), m);
+        }
+    });
+}
 
-        unsigned int startRow = currentRow;
-        unsigned int endRow = startRow + rowsPerThread + (shouldTakeRemainder ? 1 : 0); // Exclusive, so we don't need to subtract 1
-        currentRow = endRow;
+Matrix computeMatricesSequential(
+    const MatrixView& matrix1,
+    const MatrixView& matrix2,
+    RowOperation operation
+) {
+    Matrix result(matrix1.rows, matrix1.cols);
+    computeMatricesSequential(matrix1, matrix2, result, operation);
+    return result;
+}
 
-        // Creating a thread
-        threads[threadIndex] = thread([=]() {
-            for (unsigned int i = startRow; i < endRow; i++) {
-                result[i] = operation(matrix1[i], matrix2[i], m);
-            }
+Matrix computeMatricesParallel(
+    const MatrixView& matrix1,
+    const MatrixView& matrix2,
+    RowOperation operation,
+    unsigned int numberOfThreads
+) {
+    // A single allocation for the whole result instead of one per row, first touched by the threads that fill it
+    Matrix result(matrix1.rows, matrix1.cols, numberOfThreads);
+    computeMatricesParallel(matrix1, matrix2, result, operation, numberOfThreads);
+    return result;
+}
+
+// Element-wise operations as functors. Passed as template parameters they are inlined
+// into the row loop, so each operation compiles to one vectorizable loop instead of
+// an indirect call per row through `function`.
+struct AddOperation {
+    int operator()(int x, int y) const { return x + y; }
+};
+
+struct SubtractOperation {
+    int operator()(int x, int y) const { return x - y; }
+};
+
+struct ScaleOperation {
+    int scalar;
+    int operator()(int x) const { return scalar * x; }
+};
+
+// a * x + b * y
+struct AxpbyOperation {
+    int a;
+    int b;
+    int operator()(int x, int y) const { return a * x + b * y; }
+};
+
+template <typename Operation>
+inline void transformRow(
+    const int* vector1,
+    const int* vector2,
+    int* result,
+    unsigned int n,
+    Operation operation
+) {
+    for (unsigned int i = 0; i < n; i++) {
+        result[i] = operation(vector1[i], vector2[i]);
+    }
+}
+
+template <typename Operation>
+inline void transformRow(
+    const int* vector,
+    int* result,
+    unsigned int n,
+    Operation operation
+) {
+    for (unsigned int i = 0; i < n; i++) {
+        result[i] = operation(vector[i]);
+    }
+}
+
+// result = operation(matrix1, matrix2), `result` may alias an input
+template <typename Operation>
+void transformMatrices(
+    const MatrixView& matrix1,
+    const MatrixView& matrix2,
+    const MatrixView& result,
+    Operation operation,
+    unsigned int numberOfThreads = 1
+) {
+    checkSameShape(matrix1, matrix2);
+    checkSameShape(matrix1, result);
+
+    parallelFor(0, matrix1.rows, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            transformRow(matrix1.row(i), matrix2.row(i), result.row(i), matrix1.cols, operation);
+        }
+    });
+}
+
+// result = operation(matrix), `result` may alias the input
+template <typename Operation>
+void transformMatrix(
+    const MatrixView& matrix,
+    const MatrixView& result,
+    Operation operation,
+    unsigned int numberOfThreads = 1
+) {
+    checkSameShape(matrix, result);
+
+    parallelFor(0, matrix.rows, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            transformRow(matrix.row(i), result.row(i), matrix.cols, operation);
+        }
+    });
+}
+
+// Hand-vectorized add/subtract row kernels. Every ISA version is compiled with a `target`
+// attribute, so the binary runs on any x86 CPU and the best version is picked at startup.
+using SimdRowKernel = void (*)(const int*, const int*, int*, unsigned int);
+
+struct SimdKernels {
+    const char* name;
+    unsigned int vectorWidth; // Number of 32-bit integers per register
+    SimdRowKernel add;
+    SimdRowKernel subtract;
+    // Same operations with non-temporal stores, nullptr when the ISA has none
+    SimdRowKernel streamAdd;
+    SimdRowKernel streamSubtract;
+};
+
+template <bool Subtract>
+void scalarRowKernel(
+    const int* vector1,
+    const int* vector2,
+    int* result,
+    unsigned int n
+) {
+    for (unsigned int i = 0; i < n; i++) {
+        result[i] = Subtract ? vector1[i] - vector2[i] : vector1[i] + vector2[i];
+    }
+}
+
+#if HAS_X86_SIMD
+template <bool Subtract>
+__attribute__((target("sse2")))
+void sse2RowKernel(
+    const int* vector1,
+    const int* vector2,
+    int* result,
+    unsigned int n
+) {
+    unsigned int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vector1 + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vector2 + i));
+        __m128i r = Subtract ? _mm_sub_epi32(x, y) : _mm_add_epi32(x, y);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(result + i), r);
+    }
+    for (; i < n; i++) {
+        result[i] = Subtract ? vector1[i] - vector2[i] : vector1[i] + vector2[i];
+    }
+}
+
+template <bool Subtract>
+__attribute__((target("avx2")))
+void avx2RowKernel(
+    const int* vector1,
+    const int* vector2,
+    int* result,
+    unsigned int n
+) {
+    unsigned int i = 0;
+    // Two registers per iteration to keep both load ports busy
+    for (; i + 16 <= n; i += 16) {
+        __m256i x0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vector1 + i));
+        __m256i x1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vector1 + i + 8));
+        __m256i y0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vector2 + i));
+        __m256i y1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vector2 + i + 8));
+        __m256i r0 = Subtract ? _mm256_sub_epi32(x0, y0) : _mm256_add_epi32(x0, y0);
+        __m256i r1 = Subtract ? _mm256_sub_epi32(x1, y1) : _mm256_add_epi32(x1, y1);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + i), r0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + i + 8), r1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vector1 + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vector2 + i));
+        __m256i r = Subtract ? _mm256_sub_epi32(x, y) : _mm256_add_epi32(x, y);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(result + i), r);
+    }
+    for (; i < n; i++) {
+        result[i] = Subtract ? vector1[i] - vector2[i] : vector1[i] + vector2[i];
+    }
+}
+
+template <bool Subtract>
+__attribute__((target("avx512f")))
+void avx512RowKernel(
+    const int* vector1,
+    const int* vector2,
+    int* result,
+    unsigned int n
+) {
+    unsigned int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i x = _mm512_loadu_si512(vector1 + i);
+        __m512i y = _mm512_loadu_si512(vector2 + i);
+        __m512i r = Subtract ? _mm512_sub_epi32(x, y) : _mm512_add_epi32(x, y);
+        _mm512_storeu_si512(result + i, r);
+    }
+    // The tail is handled with a masked load/store instead of a scalar loop
+    if (i < n) {
+        __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+        __m512i x = _mm512_maskz_loadu_epi32(mask, vector1 + i);
+        __m512i y = _mm512_maskz_loadu_epi32(mask, vector2 + i);
+        __m512i r = Subtract ? _mm512_sub_epi32(x, y) : _mm512_add_epi32(x, y);
+        _mm512_mask_storeu_epi32(result + i, mask, r);
+    }
+}
+
+// Streaming (non-temporal) versions. The result bypasses the cache and is written without
+// reading the destination line first, which saves the read-for-ownership traffic and keeps
+// the inputs in cache when the result is much larger than the last level cache.
+// Non-temporal stores need an aligned address, so the row head is written normally.
+template <bool Subtract, size_t VectorBytes>
+inline unsigned int scalarHeadUntilAligned(
+    const int* vector1,
+    const int* vector2,
+    int* result,
+    unsigned int n
+) {
+    unsigned int i = 0;
+    while (i < n && reinterpret_cast<uintptr_t>(result + i) % VectorBytes != 0) {
+        result[i] = Subtract ? vector1[i] - vector2[i] : vector1[i] + vector2[i];
+        i++;
+    }
+    return i;
+}
+
+template <bool Subtract>
+__attribute__((target("sse2")))
+void sse2StreamRowKernel(
+    const int* vector1,
+    const int* vector2,
+    int* result,
+    unsigned int n
+) {
+    unsigned int i = scalarHeadUntilAligned<Subtract, 16>(vector1, vector2, result, n);
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vector1 + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(vector2 + i));
+        __m128i r = Subtract ? _mm_sub_epi32(x, y) : _mm_add_epi32(x, y);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(result + i), r);
+    }
+    for (; i < n; i++) {
+        result[i] = Subtract ? vector1[i] - vector2[i] : vector1[i] + vector2[i];
+    }
+    // Non-temporal stores are weakly ordered, make them visible before the row is considered done
+    _mm_sfence();
+}
+
+template <bool Subtract>
+__attribute__((target("avx2")))
+void avx2StreamRowKernel(
+    const int* vector1,
+    const int* vector2,
+    int* result,
+    unsigned int n
+) {
+    unsigned int i = scalarHeadUntilAligned<Subtract, 32>(vector1, vector2, result, n);
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vector1 + i));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(vector2 + i));
+        __m256i r = Subtract ? _mm256_sub_epi32(x, y) : _mm256_add_epi32(x, y);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(result + i), r);
+    }
+    for (; i < n; i++) {
+        result[i] = Subtract ? vector1[i] - vector2[i] : vector1[i] + vector2[i];
+    }
+    _mm_sfence();
+}
+
+template <bool Subtract>
+__attribute__((target("avx512f")))
+void avx512StreamRowKernel(
+    const int* vector1,
+    const int* vector2,
+    int* result,
+    unsigned int n
+) {
+    unsigned int i = scalarHeadUntilAligned<Subtract, 64>(vector1, vector2, result, n);
+    for (; i + 16 <= n; i += 16) {
+        __m512i x = _mm512_loadu_si512(vector1 + i);
+        __m512i y = _mm512_loadu_si512(vector2 + i);
+        __m512i r = Subtract ? _mm512_sub_epi32(x, y) : _mm512_add_epi32(x, y);
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(result + i), r);
+    }
+    if (i < n) {
+        __mmask16 mask = static_cast<__mmask16>((1u << (n - i)) - 1);
+        __m512i x = _mm512_maskz_loadu_epi32(mask, vector1 + i);
+        __m512i y = _mm512_maskz_loadu_epi32(mask, vector2 + i);
+        __m512i r = Subtract ? _mm512_sub_epi32(x, y) : _mm512_add_epi32(x, y);
+        _mm512_mask_storeu_epi32(result + i, mask, r);
+    }
+    _mm_sfence();
+}
+#endif
+
+// All kernels this CPU can run, from the narrowest to the widest
+vector<SimdKernels> availableSimdKernels() {
+    vector<SimdKernels> kernels;
+    kernels.push_back({ "Scalar", 1, scalarRowKernel<false>, scalarRowKernel<true>, nullptr, nullptr });
+
+#if HAS_X86_SIMD
+    // __builtin_cpu_supports reads CPUID (and XGETBV for OS support of the wider registers)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        kernels.push_back({
+            "SSE2", 4,
+            sse2RowKernel<false>, sse2RowKernel<true>,
+            sse2StreamRowKernel<false>, sse2StreamRowKernel<true>
+        });
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back({
+            "AVX2", 8,
+            avx2RowKernel<false>, avx2RowKernel<true>,
+            avx2StreamRowKernel<false>, avx2StreamRowKernel<true>
         });
     }
+    if (__builtin_cpu_supports("avx512f")) {
+        kernels.push_back({
+            "AVX-512", 16,
+            avx512RowKernel<false>, avx512RowKernel<true>,
+            avx512StreamRowKernel<false>, avx512StreamRowKernel<true>
+        });
+    }
+#endif
+
+    return kernels;
+}
 
-    // Starting the threads
-    for (unsigned int i = 0; i < numberOfThreads; i++) {
-        threads[i].join();
+// Detected once, on first use
+const SimdKernels& bestSimdKernels() {
+    static const SimdKernels best = availableSimdKernels().back();
+    return best;
+}
+
+enum class StoreMode {
+    Auto, // Streaming stores when the result is larger than `streamingStoreThreshold`
+    Regular,
+    Streaming
+};
+
+// Size of the last level cache in bytes, 32 MB when it cannot be detected
+size_t lastLevelCacheSize() {
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    long size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (size > 0) {
+        return size;
+    }
+#endif
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    long l2Size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (l2Size > 0) {
+        return l2Size;
     }
+#endif
+    return 32u << 20;
+}
 
-    return result;
+// Results bigger than this are written with streaming stores in `StoreMode::Auto`.
+// A result that does not fit in the last level cache would only evict the inputs.
+size_t streamingStoreThreshold = lastLevelCacheSize();
+
+bool shouldUseStreamingStores(
+    const MatrixView& result,
+    StoreMode storeMode
+) {
+    if (storeMode == StoreMode::Auto) {
+        return size_t(result.rows) * result.cols * sizeof(int) > streamingStoreThreshold;
+    }
+    return storeMode == StoreMode::Streaming;
+}
+
+// Pick the add or subtract kernel of `kernels` for the given store mode,
+// falling back to regular stores when the ISA has no streaming version
+SimdRowKernel selectRowKernel(
+    const SimdKernels& kernels,
+    bool isSubtract,
+    bool useStreamingStores
+) {
+    if (useStreamingStores) {
+        SimdRowKernel streamKernel = isSubtract ? kernels.streamSubtract : kernels.streamAdd;
+        if (streamKernel != nullptr) {
+            return streamKernel;
+        }
+    }
+    return isSubtract ? kernels.subtract : kernels.add;
+}
+
+void computeMatricesSimd(
+    const MatrixView& matrix1,
+    const MatrixView& matrix2,
+    const MatrixView& result,
+    SimdRowKernel kernel,
+    unsigned int numberOfThreads = 1
+) {
+    checkSameShape(matrix1, matrix2);
+    checkSameShape(matrix1, result);
+
+    parallelFor(0, matrix1.rows, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            kernel(matrix1.row(i), matrix2.row(i), result.row(i), matrix1.cols);
+        }
+    });
+}
+
+void addMatrices(
+    const MatrixView& matrix1,
+    const MatrixView& matrix2,
+    const MatrixView& result,
+    unsigned int numberOfThreads = 1,
+    StoreMode storeMode = StoreMode::Auto
+) {
+    SimdRowKernel kernel = selectRowKernel(bestSimdKernels(), false, shouldUseStreamingStores(result, storeMode));
+    computeMatricesSimd(matrix1, matrix2, result, kernel, numberOfThreads);
+}
+
+void subtractMatrices(
+    const MatrixView& matrix1,
+    const MatrixView& matrix2,
+    const MatrixView& result,
+    unsigned int numberOfThreads = 1,
+    StoreMode storeMode = StoreMode::Auto
+) {
+    SimdRowKernel kernel = selectRowKernel(bestSimdKernels(), true, shouldUseStreamingStores(result, storeMode));
+    computeMatricesSimd(matrix1, matrix2, result, kernel, numberOfThreads);
+}
+
+void scaleMatrix(
+    const MatrixView& matrix,
+    int scalar,
+    const MatrixView& result,
+    unsigned int numberOfThreads = 1
+) {
+    transformMatrix(matrix, result, ScaleOperation{ scalar }, numberOfThreads);
+}
+
+// result = a * matrix1 + b * matrix2
+void axpbyMatrices(
+    int a,
+    const MatrixView& matrix1,
+    int b,
+    const MatrixView& matrix2,
+    const MatrixView& result,
+    unsigned int numberOfThreads = 1
+) {
+    transformMatrices(matrix1, matrix2, result, AxpbyOperation{ a, b }, numberOfThreads);
+}
+
+// matrix1 += matrix2
+void addMatricesInPlace(
+    const MatrixView& matrix1,
+    const MatrixView& matrix2,
+    unsigned int numberOfThreads = 1
+) {
+    addMatrices(matrix1, matrix2, matrix1, numberOfThreads);
+}
+
+// matrix1 -= matrix2
+void subtractMatricesInPlace(
+    const MatrixView& matrix1,
+    const MatrixView& matrix2,
+    unsigned int numberOfThreads = 1
+) {
+    subtractMatrices(matrix1, matrix2, matrix1, numberOfThreads);
+}
+
+// sumResult = matrix1 + matrix2 and differenceResult = matrix1 - matrix2 in one sweep,
+// so both inputs are read once instead of once per operation
+void sumAndDifferenceMatrices(
+    const MatrixView& matrix1,
+    const MatrixView& matrix2,
+    const MatrixView& sumResult,
+    const MatrixView& differenceResult,
+    unsigned int numberOfThreads = 1
+) {
+    checkSameShape(matrix1, matrix2);
+    checkSameShape(matrix1, sumResult);
+    checkSameShape(matrix1, differenceResult);
+
+    unsigned int m = matrix1.cols;
+
+    parallelFor(0, matrix1.rows, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            const int* vector1 = matrix1.row(i);
+            const int* vector2 = matrix2.row(i);
+            int* sum = sumResult.row(i);
+            int* difference = differenceResult.row(i);
+
+            for (unsigned int j = 0; j < m; j++) {
+                int x = vector1[j];
+                int y = vector2[j];
+                sum[j] = x + y;
+                difference[j] = x - y;
+            }
+        }
+    });
+}
+
+// Lazily evaluated element-wise expressions.
+// `lazy(A) + lazy(B) - lazy(C)` only builds a small tree of references; `evaluate` then
+// computes every element of the result in one pass over all inputs, with no temporary matrices.
+// Each node exposes `row(i)`, an object whose `operator[](j)` gives the element (i, j),
+// so the whole tree inlines into one loop per row.
+template <typename Derived>
+struct MatrixExpression {
+    const Derived& derived() const {
+        return static_cast<const Derived&>(*this);
+    }
+};
+
+struct MatrixLeaf : MatrixExpression<MatrixLeaf> {
+    MatrixView view;
+
+    // Number of matrices read by the expression
+    static constexpr unsigned int inputCount = 1;
+
+    struct Row {
+        const int* data;
+
+        int operator[](unsigned int j) const {
+            return data[j];
+        }
+    };
+
+    explicit MatrixLeaf(const MatrixView& view) : view(view) {}
+
+    Row row(unsigned int i) const {
+        return { view.row(i) };
+    }
+
+    unsigned int rows() const { return view.rows; }
+    unsigned int cols() const { return view.cols; }
+};
+
+template <typename Left, typename Right, typename Operation>
+struct BinaryMatrixExpression : MatrixExpression<BinaryMatrixExpression<Left, Right, Operation>> {
+    Left left;
+    Right right;
+
+    static constexpr unsigned int inputCount = Left::inputCount + Right::inputCount;
+
+    struct Row {
+        typename Left::Row left;
+        typename Right::Row right;
+
+        int operator[](unsigned int j) const {
+            return Operation()(left[j], right[j]);
+        }
+    };
+
+    BinaryMatrixExpression(
+        const Left& left,
+        const Right& right
+    ) : left(left), right(right) {
+        if (left.rows() != right.rows() || left.cols() != right.cols()) {
+            throw invalid_argument("Matrices must have the same dimensions");
+        }
+    }
+
+    Row row(unsigned int i) const {
+        return { left.row(i), right.row(i) };
+    }
+
+    unsigned int rows() const { return left.rows(); }
+    unsigned int cols() const { return left.cols(); }
+};
+
+inline MatrixLeaf lazy(const MatrixView& matrix) {
+    return MatrixLeaf(matrix);
+}
+
+template <typename Left, typename Right>
+BinaryMatrixExpression<Left, Right, AddOperation> operator+(
+    const MatrixExpression<Left>& left,
+    const MatrixExpression<Right>& right
+) {
+    return { left.derived(), right.derived() };
+}
+
+template <typename Left, typename Right>
+BinaryMatrixExpression<Left, Right, SubtractOperation> operator-(
+    const MatrixExpression<Left>& left,
+    const MatrixExpression<Right>& right
+) {
+    return { left.derived(), right.derived() };
+}
+
+// result = expression, computed in one pass. `result` must not be one of the inputs.
+template <typename Expression>
+void evaluate(
+    const MatrixExpression<Expression>& expression,
+    const MatrixView& result,
+    unsigned int numberOfThreads = 1
+) {
+    const Expression& tree = expression.derived();
+    if (tree.rows() != result.rows || tree.cols() != result.cols) {
+        throw invalid_argument("Matrices must have the same dimensions");
+    }
+
+    unsigned int m = result.cols;
+
+    parallelFor(0, result.rows, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            typename Expression::Row row = tree.row(i);
+            int* output = result.row(i);
+
+            for (unsigned int j = 0; j < m; j++) {
+                output[j] = row[j];
+            }
+        }
+    });
 }
 
 // Check if two matrices are equal, for testing purposes
@@ -142,6 +987,37 @@ bool areMatricesEqual(
     return true;
 }
 
+// Compare a result in the old `int**` layout with one in the contiguous layout
+bool areMatricesEqual(
+    int** matrix1,
+    const MatrixView& matrix2
+) {
+    for (unsigned int i = 0; i < matrix2.rows; i++) {
+        if (memcmp(matrix1[i], matrix2.row(i), matrix2.cols * sizeof(int)) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool areMatricesEqual(
+    const MatrixView& matrix1,
+    const MatrixView& matrix2
+) {
+    if (matrix1.rows != matrix2.rows || matrix1.cols != matrix2.cols) {
+        return false;
+    }
+
+    for (unsigned int i = 0; i < matrix1.rows; i++) {
+        if (memcmp(matrix1.row(i), matrix2.row(i), matrix1.cols * sizeof(int)) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 double calculateSpeedup(
     double sequentialTime,
     double parallelTime
@@ -161,19 +1037,65 @@ double calculateEfficiency(
 }
 
 struct BenchmarkResult {
-    long long time;
-    int** result;
+    double time; // Median of the timed runs in milliseconds, fractional so bandwidth can be computed for small matrices
+    int** result; // Result of the last run
+    TimingStats stats;
 };
 
+// Time `function` with the shared harness, freeing the `rows`-row results of all runs but the last
 BenchmarkResult benchmarkTime(
-    function<int**()> function
+    function<int**()> function,
+    unsigned int rows
+) {
+    TimingStats stats;
+    int** result = measureRepeated(function, [&](int** unused) {
+        freeMatrix(unused, rows);
+    }, stats);
+
+    return { stats.median, result, stats };
+}
+
+struct ContiguousBenchmarkResult {
+    double time;
+    Matrix result;
+    TimingStats stats;
+};
+
+ContiguousBenchmarkResult benchmarkContiguousTime(
+    function<Matrix()> function
 ) {
-    auto start = chrono::high_resolution_clock::now();
-    int** result = function();
-    auto end = chrono::high_resolution_clock::now();
-    auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
+    TimingStats stats;
+    Matrix result = measureRepeated(function, [](Matrix) {}, stats);
 
-    return { duration.count(), result };
+    return { stats.median, move(result), stats };
+}
+
+// Time a function that writes into an existing buffer, in milliseconds (median of the timed runs).
+// In-place updates run as often as their inverse, so A += B followed by A -= B still gives A back.
+double measureTime(
+    function<void()> function
+) {
+    TimingStats stats;
+    measureRepeated([&]() {
+        function();
+        return 0;
+    }, [](int) {}, stats);
+
+    return stats.median;
+}
+
+// Element-wise operations read two matrices and write one
+double calculateBandwidth(
+    unsigned int n,
+    unsigned int m,
+    double timeMs
+) {
+    if (timeMs <= 0) {
+        return 0;
+    }
+
+    double bytes = 3.0 * n * m * sizeof(int);
+    return bytes / (timeMs * 1e6); // GB/s
 }
 
 void benchmark(
@@ -181,7 +1103,8 @@ void benchmark(
     unsigned int m,
     unsigned int numberOfThreads,
     bool runSequential = true,
-    bool runParallel = true
+    bool runParallel = true,
+    const NumaSettings& numaSettings = NumaSettings()
 ) {
     cout << "Benchmark for " << n << "x" << m << " matrix with " << numberOfThreads << " threads:" << endl;
     if (!runSequential) {
@@ -194,8 +1117,11 @@ void benchmark(
     cout << endl << "=====================" << endl << endl;
 
     cout << "- Generating matrices..." << endl << endl;
-    int** matrix1 = generateMatrix(n, m);
-    int** matrix2 = generateMatrix(n, m);
+    NumaTopology topology = setUpNuma(numaSettings, numberOfThreads);
+
+    // First touch by the threads that process each row
+    int** matrix1 = generateMatrixParallel(n, m, numberOfThreads);
+    int** matrix2 = generateMatrixParallel(n, m, numberOfThreads);
 
     BenchmarkResult sumSequentialBenchmark;
     BenchmarkResult sumParallelBenchmark;
@@ -203,8 +1129,7 @@ void benchmark(
     BenchmarkResult subtractSequentialBenchmark;
     BenchmarkResult subtractParallelBenchmark;
 
-    cout << "Press any key to continue..." << endl;
-    cin.get();
+    waitForKeyPress();
     cout << "=====================" << endl << endl;
 
     if (runSequential) {
@@ -212,13 +1137,16 @@ void benchmark(
         
         sumSequentialBenchmark = benchmarkTime([&]() {
             return computeMatricesSequential(matrix1, matrix2, sumVectors, n, m);
-        });
+        }, n);
         cout << "   - Sum: " << sumSequentialBenchmark.time << "ms" << endl;
+        printTimingStats(sumSequentialBenchmark.stats);
 
         subtractSequentialBenchmark = benchmarkTime([&]() {
             return computeMatricesSequential(matrix1, matrix2, subtractVectors, n, m);
-        });
-        cout << "   - Subtract: " << subtractSequentialBenchmark.time << "ms" << endl << endl;
+        }, n);
+        cout << "   - Subtract: " << subtractSequentialBenchmark.time << "ms" << endl;
+        printTimingStats(subtractSequentialBenchmark.stats);
+        cout << endl;
     }
 
     if (runParallel) {
@@ -226,15 +1154,350 @@ void benchmark(
 
         sumParallelBenchmark = benchmarkTime([&]() {
             return computeMatricesParallel(matrix1, matrix2, sumVectors, n, m, numberOfThreads);
-        });
+        }, n);
         cout << "   - Sum: " << sumParallelBenchmark.time << "ms" << endl;
+        printTimingStats(sumParallelBenchmark.stats);
 
         subtractParallelBenchmark = benchmarkTime([&]() {
             return computeMatricesParallel(matrix1, matrix2, subtractVectors, n, m, numberOfThreads);
+        }, n);
+        cout << "   - Subtract: " << subtractParallelBenchmark.time << "ms" << endl;
+        printTimingStats(subtractParallelBenchmark.stats);
+        cout << endl;
+    }
+
+    // Same values in a single aligned allocation, to compare against the `int**` layout
+    Matrix contiguousMatrix1 = toContiguousMatrix(matrix1, n, m, numberOfThreads);
+    Matrix contiguousMatrix2 = toContiguousMatrix(matrix2, n, m, numberOfThreads);
+
+    if (numaSettings.shouldPrintPlacement) {
+        cout << "- NUMA placement (sampled pages per thread):" << endl;
+        printNumaPlacement(topology, "Matrix 1 (int**)", n, numberOfThreads, [&](unsigned int i) {
+            return static_cast<const void*>(matrix1[i]);
+        });
+        printNumaPlacement(topology, "Matrix 1 (contiguous)", n, numberOfThreads, [&](unsigned int i) {
+            return static_cast<const void*>(contiguousMatrix1.row(i));
         });
-        cout << "   - Subtract: " << subtractParallelBenchmark.time << "ms" << endl << endl;
+        cout << endl;
     }
 
+    ContiguousBenchmarkResult sumSequentialContiguousBenchmark;
+    ContiguousBenchmarkResult sumParallelContiguousBenchmark;
+
+    ContiguousBenchmarkResult subtractSequentialContiguousBenchmark;
+    ContiguousBenchmarkResult subtractParallelContiguousBenchmark;
+
+    if (runSequential) {
+        cout << "- Running sequential algorithms (contiguous layout):" << endl;
+
+        sumSequentialContiguousBenchmark = benchmarkContiguousTime([&]() {
+            return computeMatricesSequential(contiguousMatrix1, contiguousMatrix2, sumVectorsInto);
+        });
+        cout << "   - Sum: " << sumSequentialContiguousBenchmark.time << "ms" << endl;
+        printTimingStats(sumSequentialContiguousBenchmark.stats);
+
+        subtractSequentialContiguousBenchmark = benchmarkContiguousTime([&]() {
+            return computeMatricesSequential(contiguousMatrix1, contiguousMatrix2, subtractVectorsInto);
+        });
+        cout << "   - Subtract: " << subtractSequentialContiguousBenchmark.time << "ms" << endl;
+        printTimingStats(subtractSequentialContiguousBenchmark.stats);
+        cout << endl;
+    }
+
+    if (runParallel) {
+        cout << "- Running parallel algorithms (contiguous layout):" << endl;
+
+        sumParallelContiguousBenchmark = benchmarkContiguousTime([&]() {
+            return computeMatricesParallel(contiguousMatrix1, contiguousMatrix2, sumVectorsInto, numberOfThreads);
+        });
+        cout << "   - Sum: " << sumParallelContiguousBenchmark.time << "ms" << endl;
+        printTimingStats(sumParallelContiguousBenchmark.stats);
+
+        subtractParallelContiguousBenchmark = benchmarkContiguousTime([&]() {
+            return computeMatricesParallel(contiguousMatrix1, contiguousMatrix2, subtractVectorsInto, numberOfThreads);
+        });
+        cout << "   - Subtract: " << subtractParallelContiguousBenchmark.time << "ms" << endl;
+        printTimingStats(subtractParallelContiguousBenchmark.stats);
+        cout << endl;
+    }
+
+    string size = to_string(n) + "x" + to_string(m);
+    auto recordRuns = [&](const string& name, const auto& sequentialBenchmark, const auto& parallelBenchmark) {
+        if (runSequential) {
+            recordBenchmark(name + "-sequential", size, 1, sequentialBenchmark.stats);
+        }
+        if (runParallel) {
+            double speedup = runSequential ? calculateSpeedup(sequentialBenchmark.time, parallelBenchmark.time) : 0;
+            recordBenchmark(name + "-parallel", size, numberOfThreads, parallelBenchmark.stats, speedup, calculateEfficiency(speedup, numberOfThreads));
+        }
+    };
+    recordRuns("sum", sumSequentialBenchmark, sumParallelBenchmark);
+    recordRuns("subtract", subtractSequentialBenchmark, subtractParallelBenchmark);
+    recordRuns("sum-contiguous", sumSequentialContiguousBenchmark, sumParallelContiguousBenchmark);
+    recordRuns("subtract-contiguous", subtractSequentialContiguousBenchmark, subtractParallelContiguousBenchmark);
+
+    // One result buffer reused by every run below, so the timings contain no allocation
+    Matrix outputBuffer(n, m, numberOfThreads);
+    MatrixView output = outputBuffer.view();
+
+    // Touch the buffer once so page faults are not attributed to the first timed run
+    computeMatricesSequential(contiguousMatrix1, contiguousMatrix2, output, sumVectorsInto);
+
+    auto printOutputBufferRun = [&](
+        const char* name,
+        double time,
+        const ContiguousBenchmarkResult& allocatingBenchmark
+    ) {
+        bool areEqual = areMatricesEqual(output, allocatingBenchmark.result);
+        cout << "   - " << name << ": " << time << "ms (" << calculateBandwidth(n, m, time) << " GB/s, allocating: " << allocatingBenchmark.time << "ms)" << (areEqual ? "" : " [MISMATCH]") << endl;
+    };
+
+    if (runSequential) {
+        cout << "- Running sequential algorithms (reused output buffer):" << endl;
+
+        double time = measureTime([&]() {
+            computeMatricesSequential(contiguousMatrix1, contiguousMatrix2, output, sumVectorsInto);
+        });
+        printOutputBufferRun("Sum", time, sumSequentialContiguousBenchmark);
+
+        time = measureTime([&]() {
+            computeMatricesSequential(contiguousMatrix1, contiguousMatrix2, output, subtractVectorsInto);
+        });
+        printOutputBufferRun("Subtract", time, subtractSequentialContiguousBenchmark);
+        cout << endl;
+    }
+
+    if (runParallel) {
+        cout << "- Running parallel algorithms (reused output buffer):" << endl;
+
+        double time = measureTime([&]() {
+            computeMatricesParallel(contiguousMatrix1, contiguousMatrix2, output, sumVectorsInto, numberOfThreads);
+        });
+        printOutputBufferRun("Sum", time, sumParallelContiguousBenchmark);
+
+        time = measureTime([&]() {
+            computeMatricesParallel(contiguousMatrix1, contiguousMatrix2, output, subtractVectorsInto, numberOfThreads);
+        });
+        printOutputBufferRun("Subtract", time, subtractParallelContiguousBenchmark);
+        cout << endl;
+    }
+
+    // In-place update on a copy of the first matrix: A += B followed by A -= B must give A back
+    {
+        unsigned int inPlaceThreads = runParallel ? numberOfThreads : 1;
+        Matrix inPlaceMatrix = toContiguousMatrix(matrix1, n, m, numberOfThreads);
+
+        cout << "- Running in-place algorithms (" << inPlaceThreads << " threads):" << endl;
+
+        double addTime = measureTime([&]() {
+            addMatricesInPlace(inPlaceMatrix, contiguousMatrix2, inPlaceThreads);
+        });
+        double subtractTime = measureTime([&]() {
+            subtractMatricesInPlace(inPlaceMatrix, contiguousMatrix2, inPlaceThreads);
+        });
+        bool isRestored = areMatricesEqual(matrix1, inPlaceMatrix);
+
+        cout << "   - A += B: " << addTime << "ms (" << calculateBandwidth(n, m, addTime) << " GB/s)" << endl;
+        cout << "   - A -= B: " << subtractTime << "ms (" << calculateBandwidth(n, m, subtractTime) << " GB/s)" << endl;
+        cout << "   - A restored: " << (isRestored ? "Yes" : "No") << endl << endl;
+    }
+
+    // Template-inlined kernels against the `function` row operations, both writing into reused buffers
+    Matrix inlinedBuffer(n, m, numberOfThreads);
+    MatrixView inlinedOutput = inlinedBuffer.view();
+    transformMatrices(contiguousMatrix1, contiguousMatrix2, inlinedOutput, AddOperation());
+
+    auto runInlinedComparison = [&](const char* label, unsigned int threads) {
+        cout << "- Running " << label << " algorithms (function vs inlined template):" << endl;
+
+        auto compare = [&](const char* name, RowOperation rowOperation, auto inlinedOperation) {
+            double functionTime = measureTime([&]() {
+                computeMatricesParallel(contiguousMatrix1, contiguousMatrix2, output, rowOperation, threads);
+            });
+            double inlinedTime = measureTime([&]() {
+                transformMatrices(contiguousMatrix1, contiguousMatrix2, inlinedOutput, inlinedOperation, threads);
+            });
+            bool areEqual = areMatricesEqual(output, inlinedOutput);
+
+            cout << "   - " << name << ": " << functionTime << "ms vs " << inlinedTime << "ms (" << calculateSpeedup(functionTime, inlinedTime) << "x, " << calculateBandwidth(n, m, inlinedTime) << " GB/s)" << (areEqual ? "" : " [MISMATCH]") << endl;
+        };
+
+        compare("Sum", sumVectorsInto, AddOperation());
+        compare("Subtract", subtractVectorsInto, SubtractOperation());
+
+        double scaleTime = measureTime([&]() {
+            scaleMatrix(contiguousMatrix1, 3, inlinedOutput, threads);
+        });
+        // Reads one matrix and writes one
+        cout << "   - Scale (3 * A): " << scaleTime << "ms (" << calculateBandwidth(n, m, scaleTime) * 2 / 3 << " GB/s)" << endl;
+
+        double axpbyTime = measureTime([&]() {
+            axpbyMatrices(2, contiguousMatrix1, -3, contiguousMatrix2, inlinedOutput, threads);
+        });
+        cout << "   - Axpby (2 * A - 3 * B): " << axpbyTime << "ms (" << calculateBandwidth(n, m, axpbyTime) << " GB/s)" << endl << endl;
+    };
+
+    if (runSequential) {
+        runInlinedComparison("sequential", 1);
+    }
+    if (runParallel) {
+        runInlinedComparison("parallel", numberOfThreads);
+    }
+
+    // Every SIMD level the CPU supports, checked against the scalar kernel
+    {
+        unsigned int simdThreads = runParallel ? numberOfThreads : 1;
+        const SimdKernels& selected = bestSimdKernels();
+
+        cout << "- Running SIMD kernels (" << simdThreads << " threads, selected: " << selected.name << "):" << endl;
+
+        for (const SimdKernels& kernels : availableSimdKernels()) {
+            double sumTime = measureTime([&]() {
+                computeMatricesSimd(contiguousMatrix1, contiguousMatrix2, inlinedOutput, kernels.add, simdThreads);
+            });
+            computeMatricesSimd(contiguousMatrix1, contiguousMatrix2, output, scalarRowKernel<false>);
+            bool isSumEqual = areMatricesEqual(output, inlinedOutput);
+
+            double subtractTime = measureTime([&]() {
+                computeMatricesSimd(contiguousMatrix1, contiguousMatrix2, inlinedOutput, kernels.subtract, simdThreads);
+            });
+            computeMatricesSimd(contiguousMatrix1, contiguousMatrix2, output, scalarRowKernel<true>);
+            bool isSubtractEqual = areMatricesEqual(output, inlinedOutput);
+
+            cout << "   - " << kernels.name << " (" << kernels.vectorWidth << " x int32, " << kernels.vectorWidth * 32 << "-bit):" << endl;
+            cout << "      - Sum: " << sumTime << "ms (" << calculateBandwidth(n, m, sumTime) << " GB/s)" << (isSumEqual ? "" : " [MISMATCH]") << endl;
+            cout << "      - Subtract: " << subtractTime << "ms (" << calculateBandwidth(n, m, subtractTime) << " GB/s)" << (isSubtractEqual ? "" : " [MISMATCH]") << endl;
+        }
+        cout << endl;
+    }
+
+    // Regular against streaming stores for the result
+    {
+        unsigned int storeThreads = runParallel ? numberOfThreads : 1;
+        double resultMegabytes = double(n) * m * sizeof(int) / (1 << 20);
+        bool isAutoStreaming = shouldUseStreamingStores(output, StoreMode::Auto);
+
+        cout << "- Running store modes (" << storeThreads << " threads, " << bestSimdKernels().name << "):" << endl;
+        cout << "   - Result size: " << resultMegabytes << " MB, streaming threshold: " << double(streamingStoreThreshold) / (1 << 20) << " MB" << endl;
+        cout << "   - Auto mode uses: " << (isAutoStreaming ? "streaming" : "regular") << " stores" << endl;
+
+        auto compareStoreModes = [&](const char* name, bool isSubtract) {
+            auto run = [&](StoreMode storeMode, const MatrixView& target) {
+                return measureTime([&]() {
+                    if (isSubtract) {
+                        subtractMatrices(contiguousMatrix1, contiguousMatrix2, target, storeThreads, storeMode);
+                    } else {
+                        addMatrices(contiguousMatrix1, contiguousMatrix2, target, storeThreads, storeMode);
+                    }
+                });
+            };
+
+            double regularTime = run(StoreMode::Regular, output);
+            double streamingTime = run(StoreMode::Streaming, inlinedOutput);
+            bool areEqual = areMatricesEqual(output, inlinedOutput);
+
+            cout << "   - " << name << ":" << endl;
+            cout << "      - Regular stores: " << regularTime << "ms (" << calculateBandwidth(n, m, regularTime) << " GB/s)" << endl;
+            cout << "      - Streaming stores: " << streamingTime << "ms (" << calculateBandwidth(n, m, streamingTime) << " GB/s)" << endl;
+            cout << "      - Speedup: " << calculateSpeedup(regularTime, streamingTime) << "x" << endl;
+            cout << "      - Matrices equal: " << (areEqual ? "Yes" : "No") << endl;
+        };
+
+        compareStoreModes("Sum", false);
+        compareStoreModes("Subtract", true);
+        cout << endl;
+    }
+
+    // Fused passes against one pass per operation
+    {
+        unsigned int fusedThreads = runParallel ? numberOfThreads : 1;
+        const double elementBytes = sizeof(int);
+
+        cout << "- Running fused algorithms (" << fusedThreads << " threads):" << endl;
+
+        // A + B and A - B: two passes read both inputs twice. Every pass here uses regular stores
+        // like the fused kernel, so only the number of passes differs.
+        double twoPassTime = measureTime([&]() {
+            addMatrices(contiguousMatrix1, contiguousMatrix2, output, fusedThreads, StoreMode::Regular);
+            subtractMatrices(contiguousMatrix1, contiguousMatrix2, inlinedOutput, fusedThreads, StoreMode::Regular);
+        });
+
+        Matrix fusedSum(n, m, numberOfThreads);
+        Matrix fusedDifference(n, m, numberOfThreads);
+        sumAndDifferenceMatrices(contiguousMatrix1, contiguousMatrix2, fusedSum, fusedDifference);
+
+        double fusedTime = measureTime([&]() {
+            sumAndDifferenceMatrices(contiguousMatrix1, contiguousMatrix2, fusedSum, fusedDifference, fusedThreads);
+        });
+        bool isFusedEqual = areMatricesEqual(output, fusedSum) && areMatricesEqual(inlinedOutput, fusedDifference);
+
+        cout << "   - A + B and A - B:" << endl;
+        cout << "      - Two passes: " << twoPassTime << "ms (" << 6 * elementBytes << " bytes/element)" << endl;
+        cout << "      - Fused: " << fusedTime << "ms (" << 4 * elementBytes << " bytes/element)" << endl;
+        cout << "      - Speedup: " << calculateSpeedup(twoPassTime, fusedTime) << "x" << endl;
+        cout << "      - Matrices equal: " << (isFusedEqual ? "Yes" : "No") << endl;
+
+        // (A + B) - C: a temporary for A + B against one lazy pass
+        Matrix matrix3(n, m, numberOfThreads);
+        scaleMatrix(contiguousMatrix1, 3, matrix3, fusedThreads);
+
+        // The temporary is allocated and touched up front, so only its extra pass is timed
+        Matrix temporary(n, m, numberOfThreads);
+        addMatrices(contiguousMatrix1, contiguousMatrix2, temporary, fusedThreads, StoreMode::Regular);
+
+        double temporaryTime = measureTime([&]() {
+            addMatrices(contiguousMatrix1, contiguousMatrix2, temporary, fusedThreads, StoreMode::Regular);
+            subtractMatrices(temporary, matrix3, output, fusedThreads, StoreMode::Regular);
+        });
+
+        auto expression = (lazy(contiguousMatrix1) + lazy(contiguousMatrix2)) - lazy(matrix3);
+        double lazyTime = measureTime([&]() {
+            evaluate(expression, fusedSum, fusedThreads);
+        });
+        bool isLazyEqual = areMatricesEqual(output, fusedSum);
+
+        cout << "   - (A + B) - C:" << endl;
+        cout << "      - With temporary: " << temporaryTime << "ms (" << 6 * elementBytes << " bytes/element)" << endl;
+        cout << "      - Lazy: " << lazyTime << "ms (" << (expression.inputCount + 1) * elementBytes << " bytes/element)" << endl;
+        cout << "      - Speedup: " << calculateSpeedup(temporaryTime, lazyTime) << "x" << endl;
+        cout << "      - Matrices equal: " << (isLazyEqual ? "Yes" : "No") << endl << endl;
+    }
+
+    if (runParallel) {
+        cout << "- Thread dispatch overhead (" << numberOfThreads << " threads):" << endl;
+        cout << "   - Shared pool: " << measurePoolDispatchOverhead(numberOfThreads) << "us per region" << endl;
+        cout << "   - Spawn and join: " << measureThreadSpawnOverhead(numberOfThreads) << "us per region" << endl << endl;
+    }
+
+    cout << "=====================" << endl << endl;
+    cout << "- Layout comparison (int** vs contiguous):" << endl;
+
+    auto printLayoutComparison = [&](
+        const char* name,
+        const BenchmarkResult& pointerBenchmark,
+        const ContiguousBenchmarkResult& contiguousBenchmark
+    ) {
+        double pointerBandwidth = calculateBandwidth(n, m, pointerBenchmark.time);
+        double contiguousBandwidth = calculateBandwidth(n, m, contiguousBenchmark.time);
+        bool areEqual = areMatricesEqual(pointerBenchmark.result, contiguousBenchmark.result);
+
+        cout << "   - " << name << ":" << endl;
+        cout << "      - int** bandwidth: " << pointerBandwidth << " GB/s (" << pointerBenchmark.time << "ms)" << endl;
+        cout << "      - Contiguous bandwidth: " << contiguousBandwidth << " GB/s (" << contiguousBenchmark.time << "ms)" << endl;
+        cout << "      - Bandwidth gain: " << calculateSpeedup(contiguousBandwidth, pointerBandwidth) << "x" << endl;
+        cout << "      - Matrices equal: " << (areEqual ? "Yes" : "No") << endl;
+    };
+
+    if (runSequential) {
+        printLayoutComparison("Sequential sum", sumSequentialBenchmark, sumSequentialContiguousBenchmark);
+        printLayoutComparison("Sequential subtract", subtractSequentialBenchmark, subtractSequentialContiguousBenchmark);
+    }
+    if (runParallel) {
+        printLayoutComparison("Parallel sum", sumParallelBenchmark, sumParallelContiguousBenchmark);
+        printLayoutComparison("Parallel subtract", subtractParallelBenchmark, subtractParallelContiguousBenchmark);
+    }
+    cout << endl;
+
     if (runSequential && runParallel) {
         cout << "=====================" << endl << endl;
         cout << "- Summary:" << endl;
@@ -251,6 +1514,8 @@ void benchmark(
         cout << "      - Parallel time: " << sumParallelBenchmark.time << "ms" << endl;
         cout << "      - Speedup: " << speedupSum << "x" << endl;
         cout << "      - Efficiency: " << int(efficiencySum * 100) << "%" << " (took " << sumParallelBenchmark.time << "ms vs " << sumSequentialBenchmark.time / numberOfThreads << "ms ideal)" << endl;
+        printCounterSummary("Sequential counters", sumSequentialBenchmark.stats.counters, "      ");
+        printCounterSummary("Parallel counters", sumParallelBenchmark.stats.counters, "      ");
         cout << "      - Matrices equal: " << (areEqualSum ? "Yes" : "No") << endl << endl;
 
         double speedupSubtract = calculateSpeedup(subtractSequentialBenchmark.time, subtractParallelBenchmark.time);
@@ -262,16 +1527,38 @@ void benchmark(
         cout << "      - Parallel time: " << subtractParallelBenchmark.time << "ms" << endl;
         cout << "      - Speedup: " << speedupSubtract << "x" << endl;
         cout << "      - Efficiency: " << int(efficiencySubtract * 100) << "%" << " (took " << subtractParallelBenchmark.time << "ms vs " << subtractSequentialBenchmark.time / numberOfThreads << "ms ideal)" << endl;
-        cout << "      - Matrices equal: " << (areEqualSum ? "Yes" : "No") << endl << endl;
+        printCounterSummary("Sequential counters", subtractSequentialBenchmark.stats.counters, "      ");
+        printCounterSummary("Parallel counters", subtractParallelBenchmark.stats.counters, "      ");
+        cout << "      - Matrices equal: " << (areEqualSubtract ? "Yes" : "No") << endl << endl;
+    }
+
+    // Clean up, benchmark runs once per point of a sweep
+    freeMatrix(matrix1, n);
+    freeMatrix(matrix2, n);
+    if (runSequential) {
+        freeMatrix(sumSequentialBenchmark.result, n);
+        freeMatrix(subtractSequentialBenchmark.result, n);
+    }
+    if (runParallel) {
+        freeMatrix(sumParallelBenchmark.result, n);
+        freeMatrix(subtractParallelBenchmark.result, n);
     }
 }
 
 int main(int argc, char* argv[]) {
+    Options options = parseOptions(argc, argv);
+
     if (argc < 4) {
-        cout << "Usage: <n> <m> <threads> [runSequential] [runParallel]" << endl;
+        cout << "Usage: <n> <m> <threads> [runSequential] [runParallel] [streamingThresholdMB]" << endl;
+        cout << "Options: --pin --numa-placement --simulate-numa=<nodes>" << endl;
+        cout << "         " << benchmarkUsage() << endl;
+        cout << "         " << reportUsage() << endl;
         return 1;
     }
 
+    configureBenchmark(options);
+    configureReport(options);
+
     unsigned int n = atoi(argv[1]);
     unsigned int m = atoi(argv[2]);
     unsigned int threads = atoi(argv[3]);
@@ -279,8 +1566,26 @@ int main(int argc, char* argv[]) {
     bool runSequential = argc < 5 || atoi(argv[4]) == 1;
     bool runParallel = argc < 6 || atoi(argv[5]) == 1;
 
+    // Results above this size are written with streaming stores, the default is the last level cache size
+    if (argc >= 7) {
+        streamingStoreThreshold = size_t(atof(argv[6]) * (1 << 20));
+    }
+
+    NumaSettings numaSettings;
+    numaSettings.shouldPinThreads = options.has("pin");
+    numaSettings.shouldPrintPlacement = options.has("numa-placement");
+    numaSettings.simulatedNodes = options.getInt("simulate-numa");
+
     srand(time(NULL)); // Seed the random number generator
-    benchmark(n, m, threads, runSequential, runParallel);
+    // --sizes sweeps square n x n matrices
+    bool isSizeSweep = options.has("sizes");
+    for (unsigned int size : sweepSizes(options, n)) {
+        for (unsigned int sweepThreadCount : sweepThreads(options, threads)) {
+            benchmark(isSizeSweep ? size : n, isSizeSweep ? size : m, sweepThreadCount, runSequential, runParallel, numaSettings);
+        }
+    }
+
+    writeBenchmarkReport("lab-1");
 
     return 0;
 }
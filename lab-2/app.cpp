@@ -4,163 +4,1903 @@
 #include <thread> // Needed for multithreading
 #include <functional>  // Needed to pass functions as arguments
 
+#include <random> // Needed for per-thread random generators
+#include <vector> // Needed for packed buffers
+#include <string> // Needed for variant names
+#include <cstring> // Needed for memset
+#include <sstream> // Needed to split the variant list
+#include <fstream> // Needed to read /proc/cpuinfo
+#include <algorithm> // Needed for fill, find and sort
+#include <cstdio> // Needed for sscanf
+#include <cstdint> // Needed for the typed multiplications
+#include <climits> // Needed for INT_MAX
+#include <type_traits> // Needed for is_same
+
+#include "../common/thread_pool.h" // Shared worker pool and parallelFor
+#include "../common/numa.h" // First-touch placement and thread pinning
+#include "../common/options.h" // Optional --flags
+#include "../common/csr.h" // Sparse matrices and nonzero-balanced partitioning
+#include "../common/benchmark.h" // Warm-up, repetitions and timing statistics
+#include "../common/report.h" // JSON/CSV report and size/thread sweeps
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // AVX2 and AVX-512 intrinsics
+#define HAS_X86_SIMD 1
+#else
+#define HAS_X86_SIMD 0
+#endif
+
 using namespace std;
 
-// Напишіть програми обчислення множення двох матриць (послідовний та паралельний алгоритми).
-// Порахуйте час роботи кожної з програм, обчисліть прискорення та ефективність роботи паралельного алгоритму.
+// Напишіть програми обчислення множення двох матриць (послідовний та паралельний алгоритми).
+// Порахуйте час роботи кожної з програм, обчисліть прискорення та ефективність роботи паралельного алгоритму.
+
+// В матрицях розмірності (n,m) (m,l) робіть змінними, щоб легко змінювати величину матриці. 
+
+// Кількість потоків k - також змінна величина. Програма повинна показувати час при послідовному способі
+// виконання програми, а також при розпаралеленні на k потоків. 
+
+// Зверніть увагу на випадки, коли розмірність матриці не кратна кількості потоків.!!!
+
+int** generateMatrix(
+    int n,
+    int m
+) {
+    int** matrix = new int*[n];
+
+    for (int i = 0; i < n; i++) {
+        matrix[i] = new int[m];
+
+        for (int j = 0; j < m; j++) {
+            matrix[i][j] = rand() % 100;
+        }
+    }
+
+    return matrix;
+}
+
+// Same as generateMatrix, but every row is allocated and written by the thread that
+// `parallelFor` later gives it to, so its pages land on that thread's NUMA node.
+// The second matrix is read by every thread, the row split just spreads it over the nodes.
+// With `density` < 1 every element is nonzero (1-99) with that probability and zero otherwise.
+int** generateMatrixParallel(
+    unsigned int n,
+    unsigned int m,
+    unsigned int numberOfThreads,
+    double density = 1
+) {
+    int** matrix = new int*[n];
+    unsigned int baseSeed = rand(); // Still driven by srand in main
+
+    parallelFor(0, n, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        // rand() is not thread-safe, every part gets its own generator
+        minstd_rand generator(baseSeed + startRow);
+
+        for (unsigned int i = startRow; i < endRow; i++) {
+            matrix[i] = new int[m];
+
+            for (unsigned int j = 0; j < m; j++) {
+                if (density >= 1) {
+                    matrix[i][j] = generator() % 100;
+                } else {
+                    matrix[i][j] = generator() < density * minstd_rand::max() ? 1 + generator() % 99 : 0;
+                }
+            }
+        }
+    });
+
+    return matrix;
+}
+
+// Every product is widened to `Accumulator` before it is summed, int by default
+template <typename Element, typename Accumulator = Element>
+Accumulator multiplyRowByColumn(const Element* row, Element* const* matrix2, unsigned int colIndex, unsigned int m) {
+    Accumulator sum = 0;
+    for (unsigned int i = 0; i < m; i++) {
+        sum += Accumulator(row[i]) * Accumulator(matrix2[i][colIndex]);
+    }
+    return sum;
+}
+
+// Sequential matrix multiplication, also instantiated for the element types of --types
+template <typename Element, typename Accumulator = Element>
+Accumulator** multiplyMatricesSequential(
+    Element* const* matrix1,
+    Element* const* matrix2,
+    unsigned int n,
+    unsigned int m,
+    unsigned int l
+) {
+    Accumulator** result = new Accumulator*[n];
+    for (unsigned int i = 0; i < n; i++) {
+        result[i] = new Accumulator[l];
+        for (unsigned int j = 0; j < l; j++) {
+            result[i][j] = multiplyRowByColumn<Element, Accumulator>(matrix1[i], matrix2, j, m);
+        }
+    }
+    return result;
+}
+
+// Parallel row-by-column multiplication, the original algorithm of the lab
+int** multiplyMatricesRowByColumnParallel(
+    int** matrix1,
+    int** matrix2,
+    unsigned int n,
+    unsigned int m,
+    unsigned int l,
+    unsigned int numberOfThreads
+) {
+    int** result = new int*[n];
+
+    // Rows are split between the threads of the shared pool,
+    // the first `n % numberOfThreads` threads take 1 more row to distribute the remainder
+    parallelFor(0, n, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            // Allocated by the thread that writes it, so the row is first touched on its node
+            result[i] = new int[l];
+            for (unsigned int j = 0; j < l; j++) {
+                result[i][j] = multiplyRowByColumn(matrix1[i], matrix2, j, m);
+            }
+        }
+    });
+
+    return result;
+}
+
+template <typename Value>
+void freeMatrix(Value** matrix, unsigned int n) {
+    for (unsigned int i = 0; i < n; i++) {
+        delete[] matrix[i];
+    }
+    delete[] matrix;
+}
+
+// m x l matrix to l x m, each thread writes its own rows of the transpose
+int** transposeMatrix(
+    int** matrix,
+    unsigned int m,
+    unsigned int l,
+    unsigned int numberOfThreads
+) {
+    int** transposed = new int*[l];
+
+    parallelFor(0, l, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int j = startRow; j < endRow; j++) {
+            transposed[j] = new int[m];
+        }
+
+        // Walk B in small blocks so both the reads and the writes stay in cache
+        const unsigned int BLOCK = 32;
+        for (unsigned int jb = startRow; jb < endRow; jb += BLOCK) {
+            unsigned int jEnd = min(jb + BLOCK, endRow);
+            for (unsigned int ib = 0; ib < m; ib += BLOCK) {
+                unsigned int iEnd = min(ib + BLOCK, m);
+                for (unsigned int i = ib; i < iEnd; i++) {
+                    for (unsigned int j = jb; j < jEnd; j++) {
+                        transposed[j][i] = matrix[i][j];
+                    }
+                }
+            }
+        }
+    });
+
+    return transposed;
+}
+
+int dotProduct(const int* row, const int* column, unsigned int m) {
+    int sum = 0;
+    for (unsigned int i = 0; i < m; i++) {
+        sum += row[i] * column[i];
+    }
+    return sum;
+}
+
+// Transposes B once, then every element of C is a dot product of two contiguous rows.
+// The transpose is part of the call, so its cost is part of every timing.
+int** multiplyMatricesTransposed(
+    int** matrix1,
+    int** matrix2,
+    unsigned int n,
+    unsigned int m,
+    unsigned int l,
+    unsigned int numberOfThreads,
+    double* transposeTime = nullptr
+) {
+    auto transposeStart = chrono::high_resolution_clock::now();
+    int** transposed = transposeMatrix(matrix2, m, l, numberOfThreads);
+    auto transposeEnd = chrono::high_resolution_clock::now();
+
+    if (transposeTime != nullptr) {
+        *transposeTime = chrono::duration<double, milli>(transposeEnd - transposeStart).count();
+    }
+
+    int** result = new int*[n];
+
+    parallelFor(0, n, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            result[i] = new int[l];
+            for (unsigned int j = 0; j < l; j++) {
+                result[i][j] = dotProduct(matrix1[i], transposed[j], m);
+            }
+        }
+    });
+
+    freeMatrix(transposed, l);
+
+    return result;
+}
+
+// i-k-j order: row i of C accumulates A[i][k] * (row k of B), so B is read row by row
+// and the inner loop over j is contiguous in both B and C
+int** multiplyMatricesIkj(
+    int** matrix1,
+    int** matrix2,
+    unsigned int n,
+    unsigned int m,
+    unsigned int l,
+    unsigned int numberOfThreads
+) {
+    int** result = new int*[n];
+
+    parallelFor(0, n, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            int* resultRow = new int[l];
+            memset(resultRow, 0, l * sizeof(int));
+
+            for (unsigned int k = 0; k < m; k++) {
+                int a = matrix1[i][k];
+                const int* bRow = matrix2[k];
+
+                for (unsigned int j = 0; j < l; j++) {
+                    resultRow[j] += a * bRow[j];
+                }
+            }
+
+            result[i] = resultRow;
+        }
+    });
+
+    return result;
+}
+
+// Cache blocking parameters of the tiled multiplication, in elements:
+// a kc x nc panel of B stays in L3 (and its kc-row slivers in L1),
+// an mc x kc block of A stays in L2 while it is multiplied by the whole panel
+struct GemmBlockSizes {
+    unsigned int kc = 256; // L1: depth of one rank-kc update
+    unsigned int mc = 96; // L2: rows of A per block
+    unsigned int nc = 2048; // L3: columns of B per panel
+};
+
+GemmBlockSizes gemmBlockSizes; // Set from --kc, --mc and --nc
+double cpuFrequencyOverrideGhz = 0; // Set from --cpu-ghz, read from /proc/cpuinfo when 0
+double matrixDensity = 1; // Set from --density, fraction of nonzero elements of the generated matrices
+
+// Result rows allocated and zeroed by the threads that will write them
+template <typename Value = int>
+Value** allocateZeroMatrix(
+    unsigned int n,
+    unsigned int l,
+    unsigned int numberOfThreads
+) {
+    Value** result = new Value*[n];
+
+    parallelFor(0, n, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            result[i] = new Value[l];
+            memset(result[i], 0, l * sizeof(Value));
+        }
+    });
+
+    return result;
+}
+
+// Copy B[pc, pc + kc) x [jc, jc + nc) into a contiguous kc x nc row-major panel.
+// Reading B row by row here is what removes the column walk of multiplyRowByColumn.
+void packPanelB(
+    int** matrix2,
+    unsigned int pc,
+    unsigned int kc,
+    unsigned int jc,
+    unsigned int nc,
+    int* packedB,
+    unsigned int numberOfThreads
+) {
+    parallelFor(0, kc, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int p = startRow; p < endRow; p++) {
+            memcpy(packedB + size_t(p) * nc, matrix2[pc + p] + jc, nc * sizeof(int));
+        }
+    });
+}
+
+// C[ic, ic + mc) x [jc, jc + nc) += A[ic, ic + mc) x [pc, pc + kc) * packedB.
+// The A block is packed so the whole block stays in L2; the innermost loop runs along
+// a row of the packed panel and a row of C, both contiguous, so it vectorizes.
+void multiplyBlock(
+    int** matrix1,
+    int** result,
+    const int* packedB,
+    unsigned int ic,
+    unsigned int mc,
+    unsigned int pc,
+    unsigned int kc,
+    unsigned int jc,
+    unsigned int nc,
+    int* packedA
+) {
+    for (unsigned int i = 0; i < mc; i++) {
+        memcpy(packedA + size_t(i) * kc, matrix1[ic + i] + pc, kc * sizeof(int));
+    }
+
+    for (unsigned int i = 0; i < mc; i++) {
+        int* resultRow = result[ic + i] + jc;
+        const int* aRow = packedA + size_t(i) * kc;
+
+        for (unsigned int p = 0; p < kc; p++) {
+            int a = aRow[p];
+            const int* bRow = packedB + size_t(p) * nc;
+
+            for (unsigned int j = 0; j < nc; j++) {
+                resultRow[j] += a * bRow[j];
+            }
+        }
+    }
+}
+
+// Cache-blocked multiplication with a packed copy of B (GotoBLAS loop order).
+// Every kc x nc panel of B is packed once by all threads together, then each thread
+// multiplies its own rows of A (split as in multiplyMatricesParallel) block by block.
+int** multiplyMatricesTiled(
+    int** matrix1,
+    int** matrix2,
+    unsigned int n,
+    unsigned int m,
+    unsigned int l,
+    unsigned int numberOfThreads,
+    const GemmBlockSizes& blockSizes = gemmBlockSizes
+) {
+    int** result = allocateZeroMatrix(n, l, numberOfThreads);
+
+    unsigned int kcMax = min(blockSizes.kc, m);
+    unsigned int ncMax = min(blockSizes.nc, l);
+    vector<int> packedB(size_t(kcMax) * ncMax);
+
+    for (unsigned int jc = 0; jc < l; jc += ncMax) {
+        unsigned int nc = min(ncMax, l - jc);
+
+        for (unsigned int pc = 0; pc < m; pc += kcMax) {
+            unsigned int kc = min(kcMax, m - pc);
+
+            packPanelB(matrix2, pc, kc, jc, nc, packedB.data(), numberOfThreads);
+
+            parallelFor(0, n, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+                vector<int> packedA(size_t(blockSizes.mc) * kc);
+
+                for (unsigned int ic = startRow; ic < endRow; ic += blockSizes.mc) {
+                    unsigned int mc = min(blockSizes.mc, endRow - ic);
+                    multiplyBlock(matrix1, result, packedB.data(), ic, mc, pc, kc, jc, nc, packedA.data());
+                }
+            });
+        }
+    }
+
+    return result;
+}
+
+// Register-blocked micro-kernels (BLIS/GotoBLAS style).
+//
+// A micro-kernel computes an MR x NR tile of C from an MR-row sliver of packed A and an NR-column
+// sliver of packed B, keeping the whole tile in vector registers for the full kc depth. Every
+// step loads NR values of B once and reuses them for MR rows, and broadcasts each value of A once
+// for NR columns, so the loop is bound by the multiplier rather than by loads.
+// Like the kernels of lab-1 they are compiled with a target attribute and picked at startup.
+//
+// The packing and the loops around the kernel are templates on the element type of A and B and
+// the accumulator type of C; the int path is the int/int instance, the typed modes the others.
+template <typename Element, typename Accumulator>
+using TypedGemmMicroKernel = void (*)(unsigned int, const Element*, const Element*, Accumulator* const*, unsigned int);
+
+template <typename Element, typename Accumulator>
+struct TypedGemmMicroKernels {
+    const char* name;
+    unsigned int vectorWidth; // Number of 32-bit integers per register
+    unsigned int mr; // Rows of the register tile
+    unsigned int nr; // Columns of the register tile
+    TypedGemmMicroKernel<Element, Accumulator> kernel;
+};
+
+using GemmMicroKernel = TypedGemmMicroKernel<int, int>;
+using GemmMicroKernels = TypedGemmMicroKernels<int, int>;
+
+// C[i][column + j] += sum over p of packedA[p * MR + i] * packedB[p * NR + j], for a full MR x NR tile.
+// The products are widened to the accumulator, which the compiler vectorizes as widening multiply-adds.
+template <unsigned int MR, unsigned int NR, typename Element = int, typename Accumulator = int>
+void scalarMicroKernel(
+    unsigned int kc,
+    const Element* packedA,
+    const Element* packedB,
+    Accumulator* const* cRows,
+    unsigned int column
+) {
+    Accumulator accumulators[MR][NR] = {};
+
+    for (unsigned int p = 0; p < kc; p++) {
+        for (unsigned int i = 0; i < MR; i++) {
+            Accumulator a = packedA[p * MR + i];
+            for (unsigned int j = 0; j < NR; j++) {
+                accumulators[i][j] += a * Accumulator(packedB[p * NR + j]);
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < MR; i++) {
+        for (unsigned int j = 0; j < NR; j++) {
+            cRows[i][column + j] += accumulators[i][j];
+        }
+    }
+}
+
+#if HAS_X86_SIMD
+// 6 x 16: 12 accumulators + 2 values of B + 1 broadcast of A = 15 of the 16 ymm registers
+__attribute__((target("avx2")))
+void avx2MicroKernel(
+    unsigned int kc,
+    const int* packedA,
+    const int* packedB,
+    int* const* cRows,
+    unsigned int column
+) {
+    __m256i c[6][2];
+#pragma GCC unroll 6
+    for (unsigned int i = 0; i < 6; i++) {
+        c[i][0] = _mm256_setzero_si256();
+        c[i][1] = _mm256_setzero_si256();
+    }
+
+    for (unsigned int p = 0; p < kc; p++) {
+        __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(packedB + p * 16));
+        __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(packedB + p * 16 + 8));
+
+#pragma GCC unroll 6
+        for (unsigned int i = 0; i < 6; i++) {
+            __m256i a = _mm256_set1_epi32(packedA[p * 6 + i]);
+            c[i][0] = _mm256_add_epi32(c[i][0], _mm256_mullo_epi32(a, b0));
+            c[i][1] = _mm256_add_epi32(c[i][1], _mm256_mullo_epi32(a, b1));
+        }
+    }
+
+#pragma GCC unroll 6
+    for (unsigned int i = 0; i < 6; i++) {
+        __m256i* row = reinterpret_cast<__m256i*>(cRows[i] + column);
+        _mm256_storeu_si256(row, _mm256_add_epi32(_mm256_loadu_si256(row), c[i][0]));
+        _mm256_storeu_si256(row + 1, _mm256_add_epi32(_mm256_loadu_si256(row + 1), c[i][1]));
+    }
+}
+
+// 6 x 32: the same shape with zmm registers, 15 of the 32 registers
+__attribute__((target("avx512f")))
+void avx512MicroKernel(
+    unsigned int kc,
+    const int* packedA,
+    const int* packedB,
+    int* const* cRows,
+    unsigned int column
+) {
+    __m512i c[6][2];
+#pragma GCC unroll 6
+    for (unsigned int i = 0; i < 6; i++) {
+        c[i][0] = _mm512_setzero_si512();
+        c[i][1] = _mm512_setzero_si512();
+    }
+
+    for (unsigned int p = 0; p < kc; p++) {
+        __m512i b0 = _mm512_loadu_si512(packedB + p * 32);
+        __m512i b1 = _mm512_loadu_si512(packedB + p * 32 + 16);
+
+#pragma GCC unroll 6
+        for (unsigned int i = 0; i < 6; i++) {
+            __m512i a = _mm512_set1_epi32(packedA[p * 6 + i]);
+            c[i][0] = _mm512_add_epi32(c[i][0], _mm512_mullo_epi32(a, b0));
+            c[i][1] = _mm512_add_epi32(c[i][1], _mm512_mullo_epi32(a, b1));
+        }
+    }
+
+#pragma GCC unroll 6
+    for (unsigned int i = 0; i < 6; i++) {
+        int* row = cRows[i] + column;
+        _mm512_storeu_si512(row, _mm512_add_epi32(_mm512_loadu_si512(row), c[i][0]));
+        _mm512_storeu_si512(row + 16, _mm512_add_epi32(_mm512_loadu_si512(row + 16), c[i][1]));
+    }
+}
+#endif
+
+// All micro-kernels this CPU can run, from the narrowest to the widest
+vector<GemmMicroKernels> availableMicroKernels() {
+    vector<GemmMicroKernels> kernels;
+    kernels.push_back({ "Scalar", 1, 4, 8, scalarMicroKernel<4, 8> });
+
+#if HAS_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back({ "AVX2", 8, 6, 16, avx2MicroKernel });
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        kernels.push_back({ "AVX-512", 16, 6, 32, avx512MicroKernel });
+    }
+#endif
+
+    return kernels;
+}
+
+// Detected once, on first use
+const GemmMicroKernels& bestMicroKernels() {
+    static const GemmMicroKernels best = availableMicroKernels().back();
+    return best;
+}
+
+// Copy B[pc, pc + kc) x [jc, jc + nc) into NR-column slivers, each kc x NR row-major,
+// so the micro-kernel reads B with unit stride. The last sliver is padded with zeros.
+template <typename Element>
+void packPanelBSlivers(
+    Element* const* matrix2,
+    unsigned int pc,
+    unsigned int kc,
+    unsigned int jc,
+    unsigned int nc,
+    unsigned int nr,
+    Element* packedB,
+    unsigned int numberOfThreads
+) {
+    unsigned int sliverCount = (nc + nr - 1) / nr;
+
+    parallelFor(0, sliverCount, numberOfThreads, [&](unsigned int startSliver, unsigned int endSliver) {
+        for (unsigned int s = startSliver; s < endSliver; s++) {
+            Element* sliver = packedB + size_t(s) * kc * nr;
+            unsigned int columns = min(nr, nc - s * nr);
+
+            for (unsigned int p = 0; p < kc; p++) {
+                const Element* bRow = matrix2[pc + p] + jc + s * nr;
+                for (unsigned int j = 0; j < nr; j++) {
+                    sliver[p * nr + j] = j < columns ? bRow[j] : 0;
+                }
+            }
+        }
+    });
+}
+
+// Copy A[ic, ic + mc) x [pc, pc + kc) into MR-row slivers, each kc x MR column-major,
+// so one step of the micro-kernel reads its MR values of A from one place. Padded with zeros.
+template <typename Element>
+void packBlockASlivers(
+    Element* const* matrix1,
+    unsigned int ic,
+    unsigned int mc,
+    unsigned int pc,
+    unsigned int kc,
+    unsigned int mr,
+    Element* packedA
+) {
+    for (unsigned int s = 0; s * mr < mc; s++) {
+        Element* sliver = packedA + size_t(s) * kc * mr;
+        unsigned int rows = min(mr, mc - s * mr);
+
+        for (unsigned int i = 0; i < mr; i++) {
+            const Element* aRow = i < rows ? matrix1[ic + s * mr + i] + pc : nullptr;
+            for (unsigned int p = 0; p < kc; p++) {
+                sliver[p * mr + i] = aRow != nullptr ? aRow[p] : 0;
+            }
+        }
+    }
+}
+
+// Same loop nest as multiplyMatricesTiled with packed slivers and a micro-kernel at the core.
+// Threads get whole MR-row slivers of A, so only the last thread can have a partial tile of rows.
+// Every panel of B is packed once by all threads together, the best split when n is large.
+template <typename Element, typename Accumulator>
+Accumulator** multiplyMatricesMicroKernelRows(
+    Element* const* matrix1,
+    Element* const* matrix2,
+    unsigned int n,
+    unsigned int m,
+    unsigned int l,
+    unsigned int numberOfThreads,
+    const TypedGemmMicroKernels<Element, Accumulator>& kernel,
+    const GemmBlockSizes& blockSizes
+) {
+    Accumulator** result = allocateZeroMatrix<Accumulator>(n, l, numberOfThreads);
+
+    unsigned int mr = kernel.mr;
+    unsigned int nr = kernel.nr;
+    unsigned int kcMax = min(blockSizes.kc, m);
+    unsigned int ncMax = min(blockSizes.nc, l);
+    unsigned int mcMax = max(mr, blockSizes.mc / mr * mr); // Whole slivers per block
+    vector<Element> packedB(size_t(kcMax) * ((ncMax + nr - 1) / nr * nr));
+    unsigned int rowSliverCount = (n + mr - 1) / mr;
+
+    for (unsigned int jc = 0; jc < l; jc += ncMax) {
+        unsigned int nc = min(ncMax, l - jc);
+
+        for (unsigned int pc = 0; pc < m; pc += kcMax) {
+            unsigned int kc = min(kcMax, m - pc);
+
+            packPanelBSlivers(matrix2, pc, kc, jc, nc, nr, packedB.data(), numberOfThreads);
+
+            parallelFor(0, rowSliverCount, numberOfThreads, [&](unsigned int startSliver, unsigned int endSliver) {
+                unsigned int startRow = startSliver * mr;
+                unsigned int endRow = min(endSliver * mr, n);
+
+                vector<Element> packedA(size_t(mcMax) * kc);
+                vector<Accumulator> edgeTile(size_t(mr) * nr);
+                vector<Accumulator*> cRows(mr);
+
+                for (unsigned int ic = startRow; ic < endRow; ic += mcMax) {
+                    unsigned int mc = min(mcMax, endRow - ic);
+                    packBlockASlivers(matrix1, ic, mc, pc, kc, mr, packedA.data());
+
+                    for (unsigned int jr = 0; jr < nc; jr += nr) {
+                        const Element* bSliver = packedB.data() + size_t(jr / nr) * kc * nr;
+                        unsigned int columns = min(nr, nc - jr);
+
+                        for (unsigned int ir = 0; ir < mc; ir += mr) {
+                            const Element* aSliver = packedA.data() + size_t(ir / mr) * kc * mr;
+                            unsigned int rows = min(mr, mc - ir);
+
+                            if (rows == mr && columns == nr) {
+                                for (unsigned int i = 0; i < mr; i++) {
+                                    cRows[i] = result[ic + ir + i];
+                                }
+                                kernel.kernel(kc, aSliver, bSliver, cRows.data(), jc + jr);
+                                continue;
+                            }
+
+                            // Edge tile: compute the full tile into a scratch buffer, add only its valid part
+                            fill(edgeTile.begin(), edgeTile.end(), 0);
+                            for (unsigned int i = 0; i < mr; i++) {
+                                cRows[i] = edgeTile.data() + size_t(i) * nr;
+                            }
+                            kernel.kernel(kc, aSliver, bSliver, cRows.data(), 0);
+
+                            for (unsigned int i = 0; i < rows; i++) {
+                                Accumulator* resultRow = result[ic + ir + i] + jc + jr;
+                                for (unsigned int j = 0; j < columns; j++) {
+                                    resultRow[j] += edgeTile[size_t(i) * nr + j];
+                                }
+                            }
+                        }
+                    }
+                }
+            });
+        }
+    }
+
+    return result;
+}
+
+// Thread grid of the micro-kernel multiplication: C is cut into rowParts x columnParts tiles
+// and the k dimension into depthParts slices whose partial products are summed afterwards
+struct GemmPartition {
+    unsigned int rowParts = 0; // 0 everywhere: picked by chooseGemmPartition
+    unsigned int columnParts = 0;
+    unsigned int depthParts = 0;
+};
+
+GemmPartition forcedGemmPartition; // Set from --grid=RxCxD
+
+unsigned int ceilDivide(unsigned int a, unsigned int b) {
+    return (a + b - 1) / b;
+}
+
+// Grid with the cheapest slowest thread. Splitting only rows caps the threads at n / MR, so
+// skinny and wide products also split columns and, when both are too small, the k dimension.
+// The cost is in multiply-adds: the largest tile of a thread, the A and B pieces it packs, and the
+// partial result it writes and reduces when k is split, which is why fewer k-splits win ties.
+GemmPartition chooseGemmPartition(
+    unsigned int n,
+    unsigned int m,
+    unsigned int l,
+    unsigned int numberOfThreads,
+    unsigned int mr,
+    unsigned int nr
+) {
+    const double PACKING_COST = 2; // Per element copied into a packed buffer
+    const double REDUCTION_COST = 4; // Per element of a partial result written and added back
+    const unsigned int MIN_DEPTH = 64; // Shorter k-slices cannot amortize their partial result
+
+    unsigned int rowSlivers = ceilDivide(n, mr);
+    unsigned int columnSlivers = ceilDivide(l, nr);
+    unsigned int maxDepthParts = max(1u, m / MIN_DEPTH);
+
+    GemmPartition best = { 1, 1, 1 };
+    double bestCost = -1;
+
+    for (unsigned int r = 1; r <= min(numberOfThreads, rowSlivers); r++) {
+        for (unsigned int c = 1; r * c <= numberOfThreads && c <= columnSlivers; c++) {
+            for (unsigned int d = 1; r * c * d <= numberOfThreads && d <= maxDepthParts; d++) {
+                double rows = double(ceilDivide(rowSlivers, r)) * mr;
+                double columns = double(ceilDivide(columnSlivers, c)) * nr;
+                double depth = ceilDivide(m, d);
+
+                double cost = rows * columns * depth + PACKING_COST * (rows * depth + depth * columns);
+                if (d > 1) {
+                    cost += REDUCTION_COST * rows * columns;
+                }
+
+                if (bestCost < 0 || cost < bestCost) {
+                    best = { r, c, d };
+                    bestCost = cost;
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+// C[rows] x [columns] += A[rows] x [depth] * B[depth] x [columns] on the calling thread.
+// Row i of the product goes to cRows[i - rowStart] + column, with `column` matching `columnStart`.
+template <typename Element, typename Accumulator>
+void multiplySubmatrix(
+    Element* const* matrix1,
+    Element* const* matrix2,
+    Range rows,
+    Range columns,
+    Range depth,
+    Accumulator* const* cRows,
+    unsigned int column,
+    const TypedGemmMicroKernels<Element, Accumulator>& kernel,
+    const GemmBlockSizes& blockSizes
+) {
+    unsigned int mr = kernel.mr;
+    unsigned int nr = kernel.nr;
+    unsigned int kcMax = min(blockSizes.kc, depth.end - depth.start);
+    unsigned int ncMax = min(blockSizes.nc, columns.end - columns.start);
+    unsigned int mcMax = max(mr, blockSizes.mc / mr * mr);
+
+    vector<Element> packedB(size_t(kcMax) * ceilDivide(ncMax, nr) * nr);
+    vector<Element> packedA(size_t(mcMax) * kcMax);
+    vector<Accumulator> edgeTile(size_t(mr) * nr);
+    vector<Accumulator*> tileRows(mr);
+
+    for (unsigned int jc = columns.start; jc < columns.end; jc += ncMax) {
+        unsigned int nc = min(ncMax, columns.end - jc);
+
+        for (unsigned int pc = depth.start; pc < depth.end; pc += kcMax) {
+            unsigned int kc = min(kcMax, depth.end - pc);
+
+            packPanelBSlivers(matrix2, pc, kc, jc, nc, nr, packedB.data(), 1);
+
+            for (unsigned int ic = rows.start; ic < rows.end; ic += mcMax) {
+                unsigned int mc = min(mcMax, rows.end - ic);
+                packBlockASlivers(matrix1, ic, mc, pc, kc, mr, packedA.data());
+
+                for (unsigned int jr = 0; jr < nc; jr += nr) {
+                    const Element* bSliver = packedB.data() + size_t(jr / nr) * kc * nr;
+                    unsigned int tileColumns = min(nr, nc - jr);
+                    unsigned int cColumn = column + (jc - columns.start) + jr;
+
+                    for (unsigned int ir = 0; ir < mc; ir += mr) {
+                        const Element* aSliver = packedA.data() + size_t(ir / mr) * kc * mr;
+                        unsigned int tileRowCount = min(mr, mc - ir);
+
+                        if (tileRowCount == mr && tileColumns == nr) {
+                            for (unsigned int i = 0; i < mr; i++) {
+                                tileRows[i] = cRows[ic - rows.start + ir + i];
+                            }
+                            kernel.kernel(kc, aSliver, bSliver, tileRows.data(), cColumn);
+                            continue;
+                        }
+
+                        fill(edgeTile.begin(), edgeTile.end(), 0);
+                        for (unsigned int i = 0; i < mr; i++) {
+                            tileRows[i] = edgeTile.data() + size_t(i) * nr;
+                        }
+                        kernel.kernel(kc, aSliver, bSliver, tileRows.data(), 0);
+
+                        for (unsigned int i = 0; i < tileRowCount; i++) {
+                            Accumulator* resultRow = cRows[ic - rows.start + ir + i] + cColumn;
+                            for (unsigned int j = 0; j < tileColumns; j++) {
+                                resultRow[j] += edgeTile[size_t(i) * nr + j];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Every thread of a rowParts x columnParts x depthParts grid multiplies its own piece and packs
+// its own A and B. Depth slice 0 adds straight into C, the others into private partial tiles
+// that are summed into C afterwards, row by row on all threads.
+template <typename Element, typename Accumulator>
+Accumulator** multiplyMatricesMicroKernelGrid(
+    Element* const* matrix1,
+    Element* const* matrix2,
+    unsigned int n,
+    unsigned int m,
+    unsigned int l,
+    const GemmPartition& partition,
+    const TypedGemmMicroKernels<Element, Accumulator>& kernel,
+    const GemmBlockSizes& blockSizes
+) {
+    unsigned int numberOfThreads = partition.rowParts * partition.columnParts * partition.depthParts;
+    Accumulator** result = allocateZeroMatrix<Accumulator>(n, l, numberOfThreads);
+
+    // Parts are split in whole slivers, so only the last part of each dimension has edge tiles
+    unsigned int rowSlivers = ceilDivide(n, kernel.mr);
+    unsigned int columnSlivers = ceilDivide(l, kernel.nr);
+
+    struct Part {
+        Range rows;
+        Range columns;
+        Range depth;
+        vector<Accumulator> partial; // Empty for depth slice 0
+    };
+    vector<Part> parts(numberOfThreads);
+
+    parallelRun(numberOfThreads, [&](unsigned int threadIndex) {
+        unsigned int d = threadIndex % partition.depthParts;
+        unsigned int c = threadIndex / partition.depthParts % partition.columnParts;
+        unsigned int r = threadIndex / partition.depthParts / partition.columnParts;
+
+        Part& part = parts[threadIndex];
+        Range rowSliverRange = partitionRange(0, rowSlivers, partition.rowParts, r);
+        Range columnSliverRange = partitionRange(0, columnSlivers, partition.columnParts, c);
+        part.rows = { rowSliverRange.start * kernel.mr, min(rowSliverRange.end * kernel.mr, n) };
+        part.columns = { columnSliverRange.start * kernel.nr, min(columnSliverRange.end * kernel.nr, l) };
+        part.depth = partitionRange(0, m, partition.depthParts, d);
+
+        unsigned int rowCount = part.rows.end > part.rows.start ? part.rows.end - part.rows.start : 0;
+        unsigned int columnCount = part.columns.end > part.columns.start ? part.columns.end - part.columns.start : 0;
+        if (rowCount == 0 || columnCount == 0 || part.depth.end == part.depth.start) {
+            return;
+        }
+
+        if (d == 0) {
+            multiplySubmatrix(matrix1, matrix2, part.rows, part.columns, part.depth, result + part.rows.start, part.columns.start, kernel, blockSizes);
+            return;
+        }
+
+        part.partial.assign(size_t(rowCount) * columnCount, 0);
+        vector<Accumulator*> partialRows(rowCount);
+        for (unsigned int i = 0; i < rowCount; i++) {
+            partialRows[i] = part.partial.data() + size_t(i) * columnCount;
+        }
+        multiplySubmatrix(matrix1, matrix2, part.rows, part.columns, part.depth, partialRows.data(), 0, kernel, blockSizes);
+    });
+
+    if (partition.depthParts > 1) {
+        parallelFor(0, n, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+            for (const Part& part : parts) {
+                if (part.partial.empty()) {
+                    continue;
+                }
+
+                unsigned int columnCount = part.columns.end - part.columns.start;
+                for (unsigned int i = max(startRow, part.rows.start); i < min(endRow, part.rows.end); i++) {
+                    const Accumulator* partialRow = part.partial.data() + size_t(i - part.rows.start) * columnCount;
+                    Accumulator* resultRow = result[i] + part.columns.start;
+                    for (unsigned int j = 0; j < columnCount; j++) {
+                        resultRow[j] += partialRow[j];
+                    }
+                }
+            }
+        });
+    }
+
+    return result;
+}
+
+// Micro-kernel multiplication on the grid from chooseGemmPartition, or from --grid
+template <typename Element, typename Accumulator>
+Accumulator** multiplyMatricesMicroKernel(
+    Element* const* matrix1,
+    Element* const* matrix2,
+    unsigned int n,
+    unsigned int m,
+    unsigned int l,
+    unsigned int numberOfThreads,
+    const TypedGemmMicroKernels<Element, Accumulator>& kernel,
+    const GemmBlockSizes& blockSizes = gemmBlockSizes
+) {
+    GemmPartition partition = forcedGemmPartition.rowParts > 0
+        ? forcedGemmPartition
+        : chooseGemmPartition(n, m, l, numberOfThreads, kernel.mr, kernel.nr);
+
+    if (partition.columnParts == 1 && partition.depthParts == 1) {
+        return multiplyMatricesMicroKernelRows(matrix1, matrix2, n, m, l, partition.rowParts, kernel, blockSizes);
+    }
+
+    return multiplyMatricesMicroKernelGrid(matrix1, matrix2, n, m, l, partition, kernel, blockSizes);
+}
+
+// Parallel matrix multiplication, with the widest micro-kernel as its core
+int** multiplyMatricesParallel(
+    int** matrix1,
+    int** matrix2,
+    unsigned int n,
+    unsigned int m,
+    unsigned int l,
+    unsigned int numberOfThreads
+) {
+    return multiplyMatricesMicroKernel(matrix1, matrix2, n, m, l, numberOfThreads, bestMicroKernels());
+}
+
+// Square block of a row-major buffer, the operands of the Strassen-Winograd recursion
+struct SquareView {
+    int* data;
+    size_t stride;
+    unsigned int size;
+
+    int* row(unsigned int i) const {
+        return data + i * stride;
+    }
+
+    // Quadrant (0, 0), (0, 1), (1, 0) or (1, 1) of an even-sized view
+    SquareView quadrant(unsigned int rowHalf, unsigned int columnHalf) const {
+        unsigned int half = size / 2;
+        return { data + rowHalf * half * stride + columnHalf * half, stride, half };
+    }
+};
+
+unsigned int strassenCutoff = 256; // Set from --strassen-cutoff, blocks this small use the micro-kernel
+
+// Square buffer owned by one level of the recursion
+struct SquareBuffer {
+    vector<int> storage;
+    SquareView view;
+
+    explicit SquareBuffer(unsigned int size) : storage(size_t(size) * size), view{ storage.data(), size, size } {}
+
+    // A copy would point at the storage of the original, a move keeps the storage
+    SquareBuffer(const SquareBuffer&) = delete;
+    SquareBuffer(SquareBuffer&&) = default;
+};
+
+// result = x + y, or x - y, over the rows of one part
+void addSquares(
+    SquareView x,
+    SquareView y,
+    SquareView result,
+    bool subtract,
+    unsigned int startRow,
+    unsigned int endRow
+) {
+    for (unsigned int i = startRow; i < endRow; i++) {
+        const int* xRow = x.row(i);
+        const int* yRow = y.row(i);
+        int* resultRow = result.row(i);
+        for (unsigned int j = 0; j < x.size; j++) {
+            resultRow[j] = subtract ? xRow[j] - yRow[j] : xRow[j] + yRow[j];
+        }
+    }
+}
+
+// c = a * b with the micro-kernel, rows split over the threads
+void multiplySquaresClassical(
+    SquareView a,
+    SquareView b,
+    SquareView c,
+    unsigned int numberOfThreads
+) {
+    unsigned int size = a.size;
+    vector<int*> aRows(size), bRows(size), cRows(size);
+    for (unsigned int i = 0; i < size; i++) {
+        aRows[i] = a.row(i);
+        bRows[i] = b.row(i);
+        cRows[i] = c.row(i);
+    }
+
+    parallelFor(0, size, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            memset(cRows[i], 0, size * sizeof(int));
+        }
+        multiplySubmatrix(aRows.data(), bRows.data(), { startRow, endRow }, { 0, size }, { 0, size }, cRows.data() + startRow, 0, bestMicroKernels(), gemmBlockSizes);
+    });
+}
+
+// c = a * b with Winograd's form of Strassen: 7 half-size products and 15 additions.
+// The products run side by side when there are at most 7 threads, otherwise one after
+// another with all threads each, because a region nested in a pool region runs sequentially.
+void multiplySquaresStrassen(
+    SquareView a,
+    SquareView b,
+    SquareView c,
+    unsigned int numberOfThreads
+) {
+    if (a.size <= strassenCutoff || a.size % 2 != 0) {
+        multiplySquaresClassical(a, b, c, numberOfThreads);
+        return;
+    }
+
+    unsigned int half = a.size / 2;
+    SquareView a11 = a.quadrant(0, 0), a12 = a.quadrant(0, 1), a21 = a.quadrant(1, 0), a22 = a.quadrant(1, 1);
+    SquareView b11 = b.quadrant(0, 0), b12 = b.quadrant(0, 1), b21 = b.quadrant(1, 0), b22 = b.quadrant(1, 1);
+    SquareView c11 = c.quadrant(0, 0), c12 = c.quadrant(0, 1), c21 = c.quadrant(1, 0), c22 = c.quadrant(1, 1);
+
+    // S1-S4 and T1-T4 are the sums of the Winograd form, P1-P7 the products
+    vector<SquareBuffer> s, t, p;
+    for (unsigned int i = 0; i < 7; i++) {
+        if (i < 4) {
+            s.emplace_back(half);
+            t.emplace_back(half);
+        }
+        p.emplace_back(half);
+    }
+
+    parallelFor(0, half, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        addSquares(a21, a22, s[0].view, false, startRow, endRow); // S1 = A21 + A22
+        addSquares(s[0].view, a11, s[1].view, true, startRow, endRow); // S2 = S1 - A11
+        addSquares(a11, a21, s[2].view, true, startRow, endRow); // S3 = A11 - A21
+        addSquares(a12, s[1].view, s[3].view, true, startRow, endRow); // S4 = A12 - S2
+        addSquares(b12, b11, t[0].view, true, startRow, endRow); // T1 = B12 - B11
+        addSquares(b22, t[0].view, t[1].view, true, startRow, endRow); // T2 = B22 - T1
+        addSquares(b22, b12, t[2].view, true, startRow, endRow); // T3 = B22 - B12
+        addSquares(t[1].view, b21, t[3].view, true, startRow, endRow); // T4 = T2 - B21
+    });
+
+    SquareView factors[7][2] = {
+        { a11, b11 }, // P1
+        { a12, b21 }, // P2
+        { s[3].view, b22 }, // P3
+        { a22, t[3].view }, // P4
+        { s[0].view, t[0].view }, // P5
+        { s[1].view, t[1].view }, // P6
+        { s[2].view, t[2].view } // P7
+    };
+
+    if (numberOfThreads > 1 && numberOfThreads <= 7) {
+        parallelRun(numberOfThreads, [&](unsigned int threadIndex) {
+            for (unsigned int product = threadIndex; product < 7; product += numberOfThreads) {
+                multiplySquaresStrassen(factors[product][0], factors[product][1], p[product].view, 1);
+            }
+        });
+    } else {
+        for (unsigned int product = 0; product < 7; product++) {
+            multiplySquaresStrassen(factors[product][0], factors[product][1], p[product].view, numberOfThreads);
+        }
+    }
+
+    parallelFor(0, half, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            const int* p1 = p[0].view.row(i);
+            const int* p2 = p[1].view.row(i);
+            const int* p3 = p[2].view.row(i);
+            const int* p4 = p[3].view.row(i);
+            const int* p5 = p[4].view.row(i);
+            const int* p6 = p[5].view.row(i);
+            const int* p7 = p[6].view.row(i);
+
+            for (unsigned int j = 0; j < half; j++) {
+                int u2 = p1[j] + p6[j];
+                int u3 = u2 + p7[j];
+                c11.row(i)[j] = p1[j] + p2[j];
+                c12.row(i)[j] = u2 + p5[j] + p3[j];
+                c21.row(i)[j] = u3 - p4[j];
+                c22.row(i)[j] = u3 + p5[j];
+            }
+        }
+    });
+}
+
+// Size the recursion works on: the smallest size >= `size` that halves evenly down to the cutoff
+unsigned int strassenPaddedSize(unsigned int size) {
+    unsigned int levels = 0;
+    while ((size >> levels) > strassenCutoff) {
+        levels++;
+    }
+    return ((size + (1u << levels) - 1) >> levels) << levels;
+}
+
+// Strassen-Winograd multiplication. The operands are copied, zero-padded, into square buffers of
+// strassenPaddedSize(max(n, m, l)), so any shape works, although it only pays off for large squares.
+int** multiplyMatricesStrassen(
+    int** matrix1,
+    int** matrix2,
+    unsigned int n,
+    unsigned int m,
+    unsigned int l,
+    unsigned int numberOfThreads
+) {
+    unsigned int size = strassenPaddedSize(max(n, max(m, l)));
+    SquareBuffer a(size), b(size), c(size);
+
+    parallelFor(0, size, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            if (i < n) {
+                memcpy(a.view.row(i), matrix1[i], m * sizeof(int));
+            }
+            if (i < m) {
+                memcpy(b.view.row(i), matrix2[i], l * sizeof(int));
+            }
+        }
+    });
+
+    multiplySquaresStrassen(a.view, b.view, c.view, numberOfThreads);
+
+    int** result = new int*[n];
+    parallelFor(0, n, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            result[i] = new int[l];
+            memcpy(result[i], c.view.row(i), l * sizeof(int));
+        }
+    });
+
+    return result;
+}
+
+// Clock of the CPU in GHz from /proc/cpuinfo, 0 when unknown
+double cpuFrequencyGhz() {
+    ifstream file("/proc/cpuinfo");
+    string line;
+
+    while (getline(file, line)) {
+        if (line.compare(0, 7, "cpu MHz") == 0) {
+            size_t colon = line.find(':');
+            if (colon != string::npos) {
+                return atof(line.c_str() + colon + 1) / 1000;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// Physical cores among the CPUs this process may run on: SMT siblings share one core and its
+// multipliers, so they are counted once by their (package, core) pair from sysfs. Falls back to
+// the number of logical CPUs when the topology cannot be read. Detected once, on first use.
+unsigned int physicalCoreCount() {
+    static const unsigned int count = [] {
+        vector<pair<int, int>> cores;
+        for (int cpu : allowedCpus()) {
+            string topology = "/sys/devices/system/cpu/cpu" + to_string(cpu) + "/topology/";
+            ifstream packageFile(topology + "physical_package_id");
+            ifstream coreFile(topology + "core_id");
+            int package = -1;
+            int core = -1;
+            if (!(packageFile >> package) || !(coreFile >> core)) {
+                return max(1u, thread::hardware_concurrency());
+            }
+            cores.push_back({ package, core });
+        }
+
+        sort(cores.begin(), cores.end());
+        cores.erase(unique(cores.begin(), cores.end()), cores.end());
+        return max(1u, (unsigned int)cores.size());
+    }();
+    return count;
+}
+
+// Peak integer throughput in GOP/s for `vectorWidth`-lane multiplies: at most one vector
+// multiply (plus its add) can start per cycle on each physical core, so 2 * vectorWidth ops per cycle
+double peakIntegerGops(
+    unsigned int vectorWidth,
+    unsigned int numberOfThreads,
+    double frequencyGhz
+) {
+    unsigned int cores = physicalCoreCount();
+    return 2.0 * vectorWidth * min(numberOfThreads, cores) * frequencyGhz;
+}
+
+// Copy bandwidth (bytes read + bytes written) of a buffer much larger than the caches, in GB/s
+double measureMemoryBandwidth(unsigned int numberOfThreads) {
+    const size_t SIZE = size_t(64) << 20;
+    vector<char> source(SIZE, 1);
+    vector<char> destination(SIZE, 0);
+
+    auto copy = [&]() {
+        parallelFor(0, SIZE >> 20, numberOfThreads, [&](unsigned int start, unsigned int end) {
+            memcpy(destination.data() + (size_t(start) << 20), source.data() + (size_t(start) << 20), size_t(end - start) << 20);
+        });
+    };
+
+    copy(); // Fault the pages in before timing
+    const unsigned int REPETITIONS = 3;
+    auto start = chrono::high_resolution_clock::now();
+    for (unsigned int i = 0; i < REPETITIONS; i++) {
+        copy();
+    }
+    auto end = chrono::high_resolution_clock::now();
+
+    double seconds = chrono::duration<double>(end - start).count();
+    return seconds > 0 ? 2.0 * SIZE * REPETITIONS / seconds / 1e9 : 0;
+}
+
+// Sparse x dense: row i of C is the sum of value * (row k of B) over the nonzeros (k, value) of
+// row i of A, so B is read row by row. Rows are split by nonzero count, not by row count.
+int** multiplySparseDense(
+    const CsrMatrix<int>& matrix1,
+    int** matrix2,
+    unsigned int l,
+    unsigned int numberOfThreads
+) {
+    int** result = new int*[matrix1.rows];
+
+    parallelForWeighted(nonzeroPrefix(matrix1), numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            int* resultRow = new int[l];
+            memset(resultRow, 0, l * sizeof(int));
+
+            for (size_t position = matrix1.rowStart[i]; position < matrix1.rowStart[i + 1]; position++) {
+                int value = matrix1.values[position];
+                const int* bRow = matrix2[matrix1.columns[position]];
+
+                for (unsigned int j = 0; j < l; j++) {
+                    resultRow[j] += value * bRow[j];
+                }
+            }
+
+            result[i] = resultRow;
+        }
+    });
+
+    return result;
+}
+
+// Sparse x sparse with Gustavson's algorithm: every thread accumulates a row of C in a dense
+// buffer of l elements and remembers which columns it touched. Rows are split by their
+// multiply-add count, the sum of nnz(row k of B) over the nonzeros k of the row of A.
+CsrMatrix<int> multiplySparseSparse(
+    const CsrMatrix<int>& matrix1,
+    const CsrMatrix<int>& matrix2,
+    unsigned int numberOfThreads
+) {
+    unsigned int n = matrix1.rows;
+    unsigned int l = matrix2.cols;
+
+    vector<unsigned long long> work(n + 1, 0);
+    for (unsigned int i = 0; i < n; i++) {
+        unsigned long long rowWork = 1;
+        for (size_t position = matrix1.rowStart[i]; position < matrix1.rowStart[i + 1]; position++) {
+            unsigned int k = matrix1.columns[position];
+            rowWork += matrix2.rowStart[k + 1] - matrix2.rowStart[k];
+        }
+        work[i + 1] = work[i] + rowWork;
+    }
+
+    // Rows are produced into per-row lists first, their final position is known only at the end
+    vector<vector<unsigned int>> rowColumns(n);
+    vector<vector<int>> rowValues(n);
+
+    parallelForWeighted(work, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        vector<int> accumulator(l, 0);
+        vector<char> isTouched(l, 0);
+        vector<unsigned int> touched;
+
+        for (unsigned int i = startRow; i < endRow; i++) {
+            for (size_t position = matrix1.rowStart[i]; position < matrix1.rowStart[i + 1]; position++) {
+                int value = matrix1.values[position];
+                unsigned int k = matrix1.columns[position];
+
+                for (size_t bPosition = matrix2.rowStart[k]; bPosition < matrix2.rowStart[k + 1]; bPosition++) {
+                    unsigned int j = matrix2.columns[bPosition];
+                    if (!isTouched[j]) {
+                        isTouched[j] = 1;
+                        touched.push_back(j);
+                    }
+                    accumulator[j] += value * matrix2.values[bPosition];
+                }
+            }
+
+            sort(touched.begin(), touched.end());
+            for (unsigned int j : touched) {
+                rowColumns[i].push_back(j);
+                rowValues[i].push_back(accumulator[j]);
+                accumulator[j] = 0;
+                isTouched[j] = 0;
+            }
+            touched.clear();
+        }
+    });
+
+    CsrMatrix<int> result;
+    result.rows = n;
+    result.cols = l;
+    result.rowStart.assign(n + 1, 0);
+    for (unsigned int i = 0; i < n; i++) {
+        result.rowStart[i + 1] = result.rowStart[i] + rowColumns[i].size();
+    }
+    result.columns.resize(result.nonzeros());
+    result.values.resize(result.nonzeros());
+
+    parallelFor(0, n, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            copy(rowColumns[i].begin(), rowColumns[i].end(), result.columns.begin() + result.rowStart[i]);
+            copy(rowValues[i].begin(), rowValues[i].end(), result.values.begin() + result.rowStart[i]);
+        }
+    });
+
+    return result;
+}
+
+// Dense copy of a CSR matrix, to compare it with the dense results
+int** toDenseMatrix(
+    const CsrMatrix<int>& matrix,
+    unsigned int numberOfThreads
+) {
+    int** dense = allocateZeroMatrix(matrix.rows, matrix.cols, numberOfThreads);
+
+    parallelFor(0, matrix.rows, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            for (size_t position = matrix.rowStart[i]; position < matrix.rowStart[i + 1]; position++) {
+                dense[i][matrix.columns[position]] = matrix.values[position];
+            }
+        }
+    });
+
+    return dense;
+}
+
+// Check if two matrices are equal, for testing purposes
+bool areMatricesEqual(
+    int** matrix1,
+    int** matrix2,
+    int n,
+    int m
+) {
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < m; j++) {
+            if (matrix1[i][j] != matrix2[i][j]) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+double calculateSpeedup(
+    double sequentialTime,
+    double parallelTime
+) {
+    if (parallelTime == 0) {
+        return 0;
+    }
+
+    return sequentialTime / parallelTime;
+}
+
+double calculateEfficiency(
+    double speedup,
+    int numberOfThreads
+) {
+    return speedup / numberOfThreads;
+}
+
+struct BenchmarkResult {
+    double time; // Median of the timed runs in milliseconds, fractional so GOP/s can be computed for small matrices
+    int** result; // Result of the last run
+    TimingStats stats;
+};
+
+// Time `function` with the shared harness, freeing the `rows`-row results of all runs but the last
+BenchmarkResult benchmarkTime(
+    function<int**()> function,
+    unsigned int rows
+) {
+    TimingStats stats;
+    int** result = measureRepeated(function, [&](int** unused) {
+        freeMatrix(unused, rows);
+    }, stats);
+
+    return { stats.median, result, stats };
+}
+
+// Every multiply-add is counted as 2 integer operations
+double calculateGops(
+    unsigned int n,
+    unsigned int m,
+    unsigned int l,
+    double timeMs
+) {
+    if (timeMs <= 0) {
+        return 0;
+    }
+
+    return 2.0 * n * m * l / (timeMs * 1e6);
+}
+
+// Variants picked with --variants=a,b,c, all of them but the opt-in ones when the list is empty
+vector<string> selectedVariants;
+
+// Strassen pads every shape to one large square, far more memory than skinny operands need.
+// Sparse copies both operands to CSR and builds an n x l CSR product, only worth it below --density=1.
+const vector<string> optInVariants = { "strassen", "sparse" };
+
+bool isVariantSelected(const string& name) {
+    if (selectedVariants.empty()) {
+        return find(optInVariants.begin(), optInVariants.end(), name) == optInVariants.end();
+    }
+
+    for (const string& selected : selectedVariants) {
+        if (selected == name) {
+            return true;
+        }
+    }
+
+    return false;
+}
 
-// В матрицях розмірності (n,m) (m,l) робіть змінними, щоб легко змінювати величину матриці. 
+// Element and accumulator types of the typed multiplications. Products of int8 or int16 elements
+// are summed in int32 (the pmaddwd / VNNI shape), products of int32 elements in int64, which is
+// exact for every size this lab can allocate with values below 100.
+template <typename Element, typename Accumulator>
+struct GemmType {
+    using ElementType = Element;
+    using AccumulatorType = Accumulator;
+    const char* name;
+};
 
-// Кількість потоків k - також змінна величина. Програма повинна показувати час при послідовному способі
-// виконання програми, а також при розпаралеленні на k потоків. 
+// Copy of an int matrix with `Element` rows, each row allocated and written by the thread that converts it
+template <typename Element>
+Element** toTypedMatrix(
+    int** matrix,
+    unsigned int n,
+    unsigned int m,
+    unsigned int numberOfThreads
+) {
+    Element** typed = new Element*[n];
 
-// Зверніть увагу на випадки, коли розмірність матриці не кратна кількості потоків.!!!
+    parallelFor(0, n, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            typed[i] = new Element[m];
+            for (unsigned int j = 0; j < m; j++) {
+                typed[i][j] = Element(matrix[i][j]);
+            }
+        }
+    });
 
-int** generateMatrix(
-    int n,
-    int m
+    return typed;
+}
+
+#if HAS_X86_SIMD
+// Micro-kernels for int8 and int16 elements with int32 sums, built on pmaddwd: one instruction
+// multiplies 16-bit pairs and adds each pair into a 32-bit lane, so every step covers two values
+// of k. int8 elements are widened to int16 as B is loaded. Rows p and p + 1 of the B sliver are
+// interleaved with unpacklo/unpackhi, which work within 128-bit lanes, so the accumulators hold
+// the columns in lane order and are put back in order before they are added to C. An odd kc
+// pairs its last row with zeros.
+
+// Pair (a0, a1) as the 32-bit value pmaddwd expects, a0 in the low half
+template <typename Element>
+inline int int16Pair(Element a0, Element a1) {
+    return int(uint16_t(int16_t(a0)) | (uint32_t(uint16_t(int16_t(a1))) << 16));
+}
+
+// 6 x 16 with the same register budget as avx2MicroKernel: 12 accumulators + 2 interleaved rows of B + 1 pair of A
+template <typename Element>
+__attribute__((target("avx2")))
+void avx2MaddMicroKernel(
+    unsigned int kc,
+    const Element* packedA,
+    const Element* packedB,
+    int32_t* const* cRows,
+    unsigned int column
 ) {
-    int** matrix = new int*[n];
+    static const Element zeroA[6] = {};
 
-    for (int i = 0; i < n; i++) {
-        matrix[i] = new int[m];
+    auto loadB = [packedB](unsigned int p) __attribute__((target("avx2"))) {
+        if constexpr (sizeof(Element) == 1) {
+            return _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(packedB + p * 16)));
+        } else {
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(packedB + p * 16));
+        }
+    };
 
-        for (int j = 0; j < m; j++) {
-            matrix[i][j] = rand() % 100;
+    __m256i c[6][2];
+#pragma GCC unroll 6
+    for (unsigned int i = 0; i < 6; i++) {
+        c[i][0] = _mm256_setzero_si256();
+        c[i][1] = _mm256_setzero_si256();
+    }
+
+    for (unsigned int p = 0; p < kc; p += 2) {
+        bool hasPair = p + 1 < kc;
+        const Element* a0 = packedA + p * 6;
+        const Element* a1 = hasPair ? packedA + (p + 1) * 6 : zeroA;
+        __m256i b0 = loadB(p);
+        __m256i b1 = hasPair ? loadB(p + 1) : _mm256_setzero_si256();
+        __m256i low = _mm256_unpacklo_epi16(b0, b1); // Columns 0-3 and 8-11
+        __m256i high = _mm256_unpackhi_epi16(b0, b1); // Columns 4-7 and 12-15
+
+#pragma GCC unroll 6
+        for (unsigned int i = 0; i < 6; i++) {
+            __m256i a = _mm256_set1_epi32(int16Pair(a0[i], a1[i]));
+            c[i][0] = _mm256_add_epi32(c[i][0], _mm256_madd_epi16(low, a));
+            c[i][1] = _mm256_add_epi32(c[i][1], _mm256_madd_epi16(high, a));
         }
     }
 
-    return matrix;
+#pragma GCC unroll 6
+    for (unsigned int i = 0; i < 6; i++) {
+        __m256i* row = reinterpret_cast<__m256i*>(cRows[i] + column);
+        __m256i first = _mm256_permute2x128_si256(c[i][0], c[i][1], 0x20);
+        __m256i second = _mm256_permute2x128_si256(c[i][0], c[i][1], 0x31);
+        _mm256_storeu_si256(row, _mm256_add_epi32(_mm256_loadu_si256(row), first));
+        _mm256_storeu_si256(row + 1, _mm256_add_epi32(_mm256_loadu_si256(row + 1), second));
+    }
 }
 
-int multiplyRowByColumn(int* row, int** matrix2, int colIndex, int m) {
-    int sum = 0;
-    for (int i = 0; i < m; i++) {
-        sum += row[i] * matrix2[i][colIndex];
+// 6 x 32 with zmm registers and vpdpwssd, which fuses the pair products and the add into one instruction
+template <typename Element>
+__attribute__((target("avx512f,avx512bw,avx512vnni")))
+void avx512VnniMicroKernel(
+    unsigned int kc,
+    const Element* packedA,
+    const Element* packedB,
+    int32_t* const* cRows,
+    unsigned int column
+) {
+    static const Element zeroA[6] = {};
+
+    auto loadB = [packedB](unsigned int p) __attribute__((target("avx512f,avx512bw"))) {
+        if constexpr (sizeof(Element) == 1) {
+            return _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(packedB + p * 32)));
+        } else {
+            return _mm512_loadu_si512(packedB + p * 32);
+        }
+    };
+
+    __m512i c[6][2];
+#pragma GCC unroll 6
+    for (unsigned int i = 0; i < 6; i++) {
+        c[i][0] = _mm512_setzero_si512();
+        c[i][1] = _mm512_setzero_si512();
     }
-    return sum;
+
+    for (unsigned int p = 0; p < kc; p += 2) {
+        bool hasPair = p + 1 < kc;
+        const Element* a0 = packedA + p * 6;
+        const Element* a1 = hasPair ? packedA + (p + 1) * 6 : zeroA;
+        __m512i b0 = loadB(p);
+        __m512i b1 = hasPair ? loadB(p + 1) : _mm512_setzero_si512();
+        __m512i low = _mm512_unpacklo_epi16(b0, b1); // Columns 0-3, 8-11, 16-19 and 24-27
+        __m512i high = _mm512_unpackhi_epi16(b0, b1); // Columns 4-7, 12-15, 20-23 and 28-31
+
+#pragma GCC unroll 6
+        for (unsigned int i = 0; i < 6; i++) {
+            __m512i a = _mm512_set1_epi32(int16Pair(a0[i], a1[i]));
+            c[i][0] = _mm512_dpwssd_epi32(c[i][0], low, a);
+            c[i][1] = _mm512_dpwssd_epi32(c[i][1], high, a);
+        }
+    }
+
+    // 64-bit indices into (low, high), 8 and up selecting from high
+    const __m512i firstHalf = _mm512_set_epi64(11, 10, 3, 2, 9, 8, 1, 0);
+    const __m512i secondHalf = _mm512_set_epi64(15, 14, 7, 6, 13, 12, 5, 4);
+
+#pragma GCC unroll 6
+    for (unsigned int i = 0; i < 6; i++) {
+        int32_t* row = cRows[i] + column;
+        __m512i first = _mm512_permutex2var_epi64(c[i][0], firstHalf, c[i][1]);
+        __m512i second = _mm512_permutex2var_epi64(c[i][0], secondHalf, c[i][1]);
+        _mm512_storeu_si512(row, _mm512_add_epi32(_mm512_loadu_si512(row), first));
+        _mm512_storeu_si512(row + 16, _mm512_add_epi32(_mm512_loadu_si512(row + 16), second));
+    }
+}
+#endif
+
+// Micro-kernels of the typed multiplications this CPU can run, from the narrowest to the widest.
+// Every type has the tile of the scalar int kernel with the products widened to the accumulator;
+// int32 elements with int64 sums have no SIMD kernel, there is no packed 64-bit multiply in AVX2.
+template <typename Element, typename Accumulator>
+vector<TypedGemmMicroKernels<Element, Accumulator>> availableTypedMicroKernels() {
+    vector<TypedGemmMicroKernels<Element, Accumulator>> kernels;
+    kernels.push_back({ "Scalar", 1, 4, 8, scalarMicroKernel<4, 8, Element, Accumulator> });
+
+#if HAS_X86_SIMD
+    if constexpr ((is_same<Element, int8_t>::value || is_same<Element, int16_t>::value) && is_same<Accumulator, int32_t>::value) {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            kernels.push_back({ "AVX2", 8, 6, 16, avx2MaddMicroKernel<Element> });
+        }
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni")) {
+            kernels.push_back({ "AVX-512 VNNI", 16, 6, 32, avx512VnniMicroKernel<Element> });
+        }
+    }
+#endif
+
+    return kernels;
 }
 
-// Sequential matrix multiplication
-int** multiplyMatricesSequential(
+// Exact product in 64 bits with a plain i-k-j loop, independent of every path it checks
+long long** multiplyMatricesExact(
     int** matrix1,
     int** matrix2,
     unsigned int n,
     unsigned int m,
     unsigned int l
 ) {
-    int** result = new int*[n];
+    long long** result = allocateZeroMatrix<long long>(n, l, 1);
+
     for (unsigned int i = 0; i < n; i++) {
-        result[i] = new int[l];
-        for (unsigned int j = 0; j < l; j++) {
-            result[i][j] = multiplyRowByColumn(matrix1[i], matrix2, j, m);
+        for (unsigned int k = 0; k < m; k++) {
+            long long a = matrix1[i][k];
+            for (unsigned int j = 0; j < l; j++) {
+                result[i][j] += a * matrix2[k][j];
+            }
         }
     }
+
     return result;
 }
 
-// Parallel matrix multiplication
-int** multiplyMatricesParallel(
+template <typename Value>
+bool isProductExact(
+    Value** result,
+    long long** exactResult,
+    unsigned int n,
+    unsigned int l
+) {
+    for (unsigned int i = 0; i < n; i++) {
+        for (unsigned int j = 0; j < l; j++) {
+            if ((long long)result[i][j] != exactResult[i][j]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Element types picked with --types=int8,int16,int32, all of them when the list is empty
+vector<string> selectedTypes;
+
+bool isTypeSelected(const string& name) {
+    if (selectedTypes.empty()) {
+        return true;
+    }
+
+    for (const string& selected : selectedTypes) {
+        if (selected == name) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Time one element type on the sequential path and on the micro-kernel path, and check it against the exact product
+template <typename Type>
+void benchmarkTyped(
+    const Type& type,
     int** matrix1,
     int** matrix2,
     unsigned int n,
     unsigned int m,
     unsigned int l,
-    unsigned int numberOfThreads
+    unsigned int numberOfThreads,
+    bool runSequential,
+    bool runParallel,
+    long long** exactResult
 ) {
-    // No need to use more threads than rows
-    if (numberOfThreads > n) {
-        numberOfThreads = n;
-    }
+    using Element = typename Type::ElementType;
+    using Accumulator = typename Type::AccumulatorType;
 
-    int** result = new int*[n];
-    for (unsigned int i = 0; i < n; i++) {
-        result[i] = new int[l];
+    if (!isTypeSelected(type.name)) {
+        return;
     }
 
-    unsigned int rowsPerThread = n / numberOfThreads;
-    unsigned int remainingRows = n % numberOfThreads;
+    Element** typed1 = toTypedMatrix<Element>(matrix1, n, m, numberOfThreads);
+    Element** typed2 = toTypedMatrix<Element>(matrix2, m, l, numberOfThreads);
 
-    thread* threads = new thread[numberOfThreads];
+    cout << "- " << type.name << " elements, " << sizeof(Accumulator) * 8 << "-bit accumulators:" << endl;
 
-    unsigned int currentRow = 0;
+    string size = to_string(n) + "x" + to_string(m) + "x" + to_string(l);
+    auto run = [&](const string& label, const string& algorithm, unsigned int threads, function<Accumulator**()> multiply) {
+        TimingStats stats;
+        Accumulator** result = measureRepeated(multiply, [&](Accumulator** unused) {
+            freeMatrix(unused, n);
+        }, stats);
 
-    for (unsigned int threadIndex = 0; threadIndex < numberOfThreads; threadIndex++) {
-        // The first `remainingRows` threads will take 1 more row to distribute the remainder
-        bool shouldTakeRemainder = threadIndex < remainingRows;
+        bool isExact = isProductExact(result, exactResult, n, l);
+        cout << "   - " << label << ": " << stats.median << "ms (" << calculateGops(n, m, l, stats.median) << " GOP/s), exact: " << (isExact ? "Yes" : "No (accumulator overflow)") << endl;
+        printTimingStats(stats);
+        recordBenchmark("typed-" + string(type.name) + "-" + algorithm, size, threads, stats);
+        freeMatrix(result, n);
+    };
 
-        unsigned int startRow = currentRow;
-        unsigned int endRow = startRow + rowsPerThread + (shouldTakeRemainder ? 1 : 0);
-        currentRow = endRow;
-
-        // Creating a thread
-        threads[threadIndex] = thread([=]() {
-            for (unsigned int i = startRow; i < endRow; i++) {
-                for (unsigned int j = 0; j < l; j++) {
-                    result[i][j] = multiplyRowByColumn(matrix1[i], matrix2, j, m);
-                }
-            }
+    if (runSequential) {
+        run("Sequential", "sequential", 1, [&]() {
+            return multiplyMatricesSequential<Element, Accumulator>(typed1, typed2, n, m, l);
         });
     }
 
-    // Starting the threads
-    for (unsigned int i = 0; i < numberOfThreads; i++) {
-        threads[i].join();
+    // Every type runs on the Scalar kernel, so the types compare on the same code, and then on its widest SIMD kernel
+    if (runParallel) {
+        vector<TypedGemmMicroKernels<Element, Accumulator>> kernels = availableTypedMicroKernels<Element, Accumulator>();
+        run("Parallel, Scalar micro-kernel", "parallel", numberOfThreads, [&]() {
+            return multiplyMatricesMicroKernel(typed1, typed2, n, m, l, numberOfThreads, kernels.front());
+        });
+
+        if (kernels.size() > 1) {
+            const TypedGemmMicroKernels<Element, Accumulator>& widest = kernels.back();
+            string kernelName = widest.name;
+            string algorithm = "parallel-" + kernelName;
+            replace(algorithm.begin(), algorithm.end(), ' ', '-');
+            run("Parallel, " + kernelName + " micro-kernel", algorithm, numberOfThreads, [&]() {
+                return multiplyMatricesMicroKernel(typed1, typed2, n, m, l, numberOfThreads, widest);
+            });
+        }
     }
 
-    return result;
+    freeMatrix(typed1, n);
+    freeMatrix(typed2, m);
 }
 
-// Check if two matrices are equal, for testing purposes
-bool areMatricesEqual(
-    int** matrix1,
-    int** matrix2,
-    int n,
-    int m
+// Batched multiplication of many small matrices of the same shape.
+//
+// Matrix b of a batch starts at element b * rows * cols of one contiguous buffer, so a batch is
+// a single allocation however many products it holds. Threads take whole products: a small product
+// is far too short to split, and the per-region cost is paid once for the whole batch.
+
+using SmallGemmKernel = void (*)(const int*, const int*, int*);
+
+// c = a * b for N x M by M x L matrices. The sizes are compile-time constants, so the compiler
+// vectorizes the j loop without a remainder and keeps the row of C in registers.
+template <unsigned int N, unsigned int M, unsigned int L>
+void multiplySmallFixed(
+    const int* a,
+    const int* b,
+    int* c
 ) {
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < m; j++) {
-            if (matrix1[i][j] != matrix2[i][j]) {
-                return false;
+    for (unsigned int i = 0; i < N; i++) {
+        int row[L] = {};
+
+        for (unsigned int k = 0; k < M; k++) {
+            int aik = a[i * M + k];
+#pragma GCC unroll 16
+            for (unsigned int j = 0; j < L; j++) {
+                row[j] += aik * b[k * L + j];
             }
         }
+
+        for (unsigned int j = 0; j < L; j++) {
+            c[i * L + j] = row[j];
+        }
     }
+}
 
-    return true;
+// Same product for any size
+void multiplySmallGeneric(
+    const int* a,
+    const int* b,
+    int* c,
+    unsigned int n,
+    unsigned int m,
+    unsigned int l
+) {
+    for (unsigned int i = 0; i < n; i++) {
+        int* cRow = c + size_t(i) * l;
+        memset(cRow, 0, l * sizeof(int));
+
+        for (unsigned int k = 0; k < m; k++) {
+            int aik = a[size_t(i) * m + k];
+            const int* bRow = b + size_t(k) * l;
+            for (unsigned int j = 0; j < l; j++) {
+                cRow[j] += aik * bRow[j];
+            }
+        }
+    }
 }
 
-double calculateSpeedup(
-    double sequentialTime,
-    double parallelTime
+// Specialized kernel for the common square sizes, nullptr for any other shape
+SmallGemmKernel findSmallGemmKernel(
+    unsigned int n,
+    unsigned int m,
+    unsigned int l
 ) {
-    if (parallelTime == 0) {
-        return 0;
+    if (n != m || m != l) {
+        return nullptr;
     }
 
-    return sequentialTime / parallelTime;
+    switch (n) {
+        case 4: return multiplySmallFixed<4, 4, 4>;
+        case 8: return multiplySmallFixed<8, 8, 8>;
+        case 16: return multiplySmallFixed<16, 16, 16>;
+        case 32: return multiplySmallFixed<32, 32, 32>;
+        case 64: return multiplySmallFixed<64, 64, 64>;
+        default: return nullptr;
+    }
 }
 
-double calculateEfficiency(
-    double speedup,
-    int numberOfThreads
+// result[b] = batch1[b] * batch2[b] for every b in [0, batchCount), whole products per thread.
+// With `useSpecializedKernels` the unrolled kernel of findSmallGemmKernel is used when there is one.
+void multiplyMatricesBatched(
+    const int* batch1,
+    const int* batch2,
+    int* result,
+    unsigned int batchCount,
+    unsigned int n,
+    unsigned int m,
+    unsigned int l,
+    unsigned int numberOfThreads,
+    bool useSpecializedKernels = true
 ) {
-    return speedup / numberOfThreads;
+    SmallGemmKernel kernel = useSpecializedKernels ? findSmallGemmKernel(n, m, l) : nullptr;
+    size_t size1 = size_t(n) * m;
+    size_t size2 = size_t(m) * l;
+    size_t resultSize = size_t(n) * l;
+
+    parallelFor(0, batchCount, numberOfThreads, [&](unsigned int start, unsigned int end) {
+        for (unsigned int b = start; b < end; b++) {
+            if (kernel != nullptr) {
+                kernel(batch1 + b * size1, batch2 + b * size2, result + b * resultSize);
+            } else {
+                multiplySmallGeneric(batch1 + b * size1, batch2 + b * size2, result + b * resultSize, n, m, l);
+            }
+        }
+    });
 }
 
-struct BenchmarkResult {
-    long long time;
-    int** result;
-};
+// Contiguous batch of `batchCount` random n x m matrices, written by the threads that multiply them
+vector<int> generateBatchParallel(
+    unsigned int batchCount,
+    unsigned int n,
+    unsigned int m,
+    unsigned int numberOfThreads
+) {
+    size_t size = size_t(n) * m;
+    vector<int> batch(batchCount * size);
+    unsigned int baseSeed = rand();
 
-BenchmarkResult benchmarkTime(
-    function<int**()> function
+    parallelFor(0, batchCount, numberOfThreads, [&](unsigned int start, unsigned int end) {
+        minstd_rand generator(baseSeed + start);
+        for (size_t i = start * size; i < end * size; i++) {
+            batch[i] = generator() % 100;
+        }
+    });
+
+    return batch;
+}
+
+// --batch=<count>: `count` independent products of n x m by m x l matrices, without the interactive pause
+void benchmarkBatched(
+    unsigned int n,
+    unsigned int m,
+    unsigned int l,
+    unsigned int numberOfThreads,
+    unsigned int batchCount
 ) {
-    auto start = chrono::high_resolution_clock::now();
-    int** result = function();
-    auto end = chrono::high_resolution_clock::now();
-    auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
+    cout << "Batched benchmark for " << batchCount << " products of " << n << "x" << m << " by " << m << "x" << l
+         << " matrices with " << numberOfThreads << " threads:" << endl;
+    cout << "- Specialized kernel: " << (findSmallGemmKernel(n, m, l) != nullptr ? "Yes" : "No (generic loops)") << endl;
+
+    cout << endl << "=====================" << endl << endl;
 
-    return { duration.count(), result };
+    vector<int> batch1 = generateBatchParallel(batchCount, n, m, numberOfThreads);
+    vector<int> batch2 = generateBatchParallel(batchCount, m, l, numberOfThreads);
+    vector<int> reference(size_t(batchCount) * n * l);
+    vector<int> result(size_t(batchCount) * n * l);
+
+    double operations = double(batchCount) * 2.0 * n * m * l;
+
+    string size = to_string(batchCount) + "x" + to_string(n) + "x" + to_string(m) + "x" + to_string(l);
+    // Every run overwrites the whole output, so the runs share it and nothing has to be released
+    auto runBatched = [&](const string& algorithm, const string& description, vector<int>& output, unsigned int threads, bool useSpecializedKernels) {
+        TimingStats stats;
+        measureRepeated([&]() {
+            multiplyMatricesBatched(batch1.data(), batch2.data(), output.data(), batchCount, n, m, l, threads, useSpecializedKernels);
+            return output.data();
+        }, [](int*) {}, stats);
+        double time = stats.median;
+
+        cout << "- Running " << description << ":" << endl;
+        cout << "   - Time: " << time << "ms (" << (time > 0 ? operations / (time * 1e6) : 0) << " GOP/s, "
+             << (batchCount > 0 ? time * 1e6 / batchCount : 0) << "ns per product)" << endl;
+        printTimingStats(stats);
+        recordBenchmark(algorithm, size, threads, stats);
+        return time;
+    };
+
+    double sequentialTime = runBatched("batched-generic-sequential", "sequential generic batch", reference, 1, false);
+    double parallelGenericTime = runBatched("batched-generic-parallel", "parallel generic batch", result, numberOfThreads, false);
+    cout << "   - Speedup: " << calculateSpeedup(sequentialTime, parallelGenericTime) << "x" << endl;
+    cout << "   - Matrices equal: " << (result == reference ? "Yes" : "No") << endl;
+
+    fill(result.begin(), result.end(), 0);
+    double parallelSpecializedTime = runBatched("batched-specialized-parallel", "parallel specialized batch", result, numberOfThreads, true);
+    cout << "   - Speedup: " << calculateSpeedup(sequentialTime, parallelSpecializedTime) << "x" << endl;
+    cout << "   - Matrices equal: " << (result == reference ? "Yes" : "No") << endl << endl;
 }
 
 void benchmark(
@@ -169,7 +1909,8 @@ void benchmark(
     unsigned int l,
     unsigned int numberOfThreads,
     bool runSequential = true,
-    bool runParallel = true
+    bool runParallel = true,
+    const NumaSettings& numaSettings = NumaSettings()
 ) {
     cout << "Benchmark for " << n << "x" << m << " matrix with " << l << " result columns and " << numberOfThreads << " threads:" << endl;
     if (!runSequential) {
@@ -178,33 +1919,235 @@ void benchmark(
     if (!runParallel) {
         cout << "- Skipping parallel algorithms" << endl;
     }
+    if (matrixDensity < 1) {
+        cout << "- Density of nonzeros: " << matrixDensity << endl;
+    }
 
     cout << endl << "=====================" << endl << endl;
 
     cout << "- Generating matrices..." << endl << endl;
-    int** matrix1 = generateMatrix(n, m);
-    int** matrix2 = generateMatrix(m, l);
+    NumaTopology topology = setUpNuma(numaSettings, numberOfThreads);
+
+    // First touch by the threads that process each row
+    int** matrix1 = generateMatrixParallel(n, m, numberOfThreads, matrixDensity);
+    int** matrix2 = generateMatrixParallel(m, l, numberOfThreads, matrixDensity);
+
+    if (numaSettings.shouldPrintPlacement) {
+        cout << "- NUMA placement (sampled pages per thread):" << endl;
+        printNumaPlacement(topology, "Matrix 1", n, numberOfThreads, [&](unsigned int i) {
+            return static_cast<const void*>(matrix1[i]);
+        });
+        printNumaPlacement(topology, "Matrix 2", m, numberOfThreads, [&](unsigned int i) {
+            return static_cast<const void*>(matrix2[i]);
+        });
+        cout << endl;
+    }
 
     BenchmarkResult multiplySequentialBenchmark;
     BenchmarkResult multiplyParallelBenchmark;
-    cout << "Press any key to continue..." << endl;
-    cin.get();
+    waitForKeyPress();
     cout << "=====================" << endl << endl;
 
     if (runSequential) {
         cout << "- Running sequential matrix multiplication:" << endl;
         multiplySequentialBenchmark = benchmarkTime([&]() {
             return multiplyMatricesSequential(matrix1, matrix2, n, m, l);
-        });
+        }, n);
         cout << "   - Time: " << multiplySequentialBenchmark.time << "ms" << endl;
+        printTimingStats(multiplySequentialBenchmark.stats);
     }
 
     if (runParallel) {
-        cout << "- Running parallel matrix multiplication:" << endl;
+        GemmPartition partition = forcedGemmPartition.rowParts > 0
+            ? forcedGemmPartition
+            : chooseGemmPartition(n, m, l, numberOfThreads, bestMicroKernels().mr, bestMicroKernels().nr);
+        cout << "- Running parallel matrix multiplication (" << bestMicroKernels().name << " micro-kernel, "
+             << partition.rowParts << "x" << partition.columnParts << "x" << partition.depthParts << " rows x columns x k grid):" << endl;
         multiplyParallelBenchmark = benchmarkTime([&]() {
             return multiplyMatricesParallel(matrix1, matrix2, n, m, l, numberOfThreads);
-        });
+        }, n);
         cout << "   - Time: " << multiplyParallelBenchmark.time << "ms" << endl;
+        printTimingStats(multiplyParallelBenchmark.stats);
+    }
+
+    // Every additional variant is checked against the sequential result, or the parallel one
+    int** referenceResult = runSequential ? multiplySequentialBenchmark.result : (runParallel ? multiplyParallelBenchmark.result : nullptr);
+    double referenceTime = runSequential ? multiplySequentialBenchmark.time : (runParallel ? multiplyParallelBenchmark.time : 0);
+
+    string size = to_string(n) + "x" + to_string(m) + "x" + to_string(l);
+    if (runSequential) {
+        recordBenchmark("sequential", size, 1, multiplySequentialBenchmark.stats);
+    }
+    if (runParallel) {
+        double speedup = runSequential ? calculateSpeedup(multiplySequentialBenchmark.time, multiplyParallelBenchmark.time) : 0;
+        recordBenchmark("parallel", size, numberOfThreads, multiplyParallelBenchmark.stats, speedup, calculateEfficiency(speedup, numberOfThreads));
+    }
+
+    // `algorithm` is the variant name, optionally followed by "-<detail>" for the report ("ikj-parallel").
+    // Returns the time of the variant in ms, or a negative value when it was not selected.
+    auto runVariant = [&](const string& algorithm, const string& description, unsigned int threads, function<int**()> multiply) {
+        if (!isVariantSelected(algorithm.substr(0, algorithm.find('-')))) {
+            return -1.0;
+        }
+
+        BenchmarkResult variantBenchmark = benchmarkTime(multiply, n);
+
+        cout << "- Running " << description << ":" << endl;
+        cout << "   - Time: " << variantBenchmark.time << "ms (" << calculateGops(n, m, l, variantBenchmark.time) << " GOP/s)" << endl;
+        printTimingStats(variantBenchmark.stats);
+        if (referenceResult != nullptr) {
+            bool areEqual = areMatricesEqual(referenceResult, variantBenchmark.result, n, l);
+            cout << "   - Speedup over " << (runSequential ? "sequential" : "parallel") << ": " << calculateSpeedup(referenceTime, variantBenchmark.time) << "x" << endl;
+            cout << "   - Matrices equal: " << (areEqual ? "Yes" : "No") << endl;
+        }
+
+        // Speedup against the sequential run only, like the other records
+        double speedup = runSequential ? calculateSpeedup(multiplySequentialBenchmark.time, variantBenchmark.time) : 0;
+        recordBenchmark(algorithm, size, threads, variantBenchmark.stats, speedup, calculateEfficiency(speedup, threads));
+
+        freeMatrix(variantBenchmark.result, n);
+        return variantBenchmark.time;
+    };
+
+    if (runSequential || runParallel) {
+        cout << endl << "- Reference throughput:" << endl;
+        if (runSequential) {
+            cout << "   - Sequential: " << calculateGops(n, m, l, multiplySequentialBenchmark.time) << " GOP/s" << endl;
+        }
+        if (runParallel) {
+            cout << "   - Parallel: " << calculateGops(n, m, l, multiplyParallelBenchmark.time) << " GOP/s" << endl;
+        }
+        cout << endl;
+    }
+
+    for (unsigned int threads : { 1u, numberOfThreads }) {
+        string label = threads == 1 ? "sequential" : "parallel";
+
+        double transposeTime = 0;
+        runVariant("transposed-" + label, label + " transposed-B multiplication (transpose included)", threads, [&]() {
+            return multiplyMatricesTransposed(matrix1, matrix2, n, m, l, threads, &transposeTime);
+        });
+        if (isVariantSelected("transposed")) {
+            cout << "   - Transpose alone: " << transposeTime << "ms" << endl;
+        }
+
+        runVariant("ikj-" + label, label + " i-k-j multiplication", threads, [&]() {
+            return multiplyMatricesIkj(matrix1, matrix2, n, m, l, threads);
+        });
+
+        if (numberOfThreads == 1) {
+            break;
+        }
+    }
+
+    runVariant("tiled", "tiled matrix multiplication (kc=" + to_string(gemmBlockSizes.kc) + ", mc=" + to_string(gemmBlockSizes.mc) + ", nc=" + to_string(gemmBlockSizes.nc) + ")", numberOfThreads, [&]() {
+        return multiplyMatricesTiled(matrix1, matrix2, n, m, l, numberOfThreads);
+    });
+
+    if (isVariantSelected("strassen")) {
+        unsigned int paddedSize = strassenPaddedSize(max(n, max(m, l)));
+
+        // The three padded squares, the temporaries of the recursion add about as much again
+        double paddedElements = 3.0 * paddedSize * paddedSize;
+        double operandElements = double(n) * m + double(m) * l + double(n) * l;
+
+        if (paddedElements > 4 * operandElements) {
+            cout << "- Skipping Strassen-Winograd multiplication: padding to " << paddedSize << "x" << paddedSize << " needs "
+                 << paddedElements / operandElements << " times the elements of the operands" << endl;
+        } else {
+            runVariant("strassen", "Strassen-Winograd multiplication (cutoff " + to_string(strassenCutoff) + ", padded to " + to_string(paddedSize) + ")", numberOfThreads, [&]() {
+                return multiplyMatricesStrassen(matrix1, matrix2, n, m, l, numberOfThreads);
+            });
+        }
+    }
+
+    runVariant("rowbycolumn", "parallel row-by-column multiplication", numberOfThreads, [&]() {
+        return multiplyMatricesRowByColumnParallel(matrix1, matrix2, n, m, l, numberOfThreads);
+    });
+
+    // Without --variants the sparse paths run on their own only for matrices generated with zeros
+    if (isVariantSelected("sparse") || (selectedVariants.empty() && matrixDensity < 1)) {
+        auto conversionStart = chrono::high_resolution_clock::now();
+        auto isNonzero = [](int value) { return value != 0; };
+        CsrMatrix<int> sparse1 = toCsrMatrix<int>(matrix1, n, m, numberOfThreads, isNonzero);
+        CsrMatrix<int> sparse2 = toCsrMatrix<int>(matrix2, m, l, numberOfThreads, isNonzero);
+        auto conversionEnd = chrono::high_resolution_clock::now();
+
+        cout << endl << "- Sparse operands (CSR): " << sparse1.nonzeros() << " and " << sparse2.nonzeros() << " nonzeros, converted in "
+             << chrono::duration<double, milli>(conversionEnd - conversionStart).count() << "ms" << endl;
+
+        runVariant("sparse-dense", "sparse x dense multiplication", numberOfThreads, [&]() {
+            return multiplySparseDense(sparse1, matrix2, l, numberOfThreads);
+        });
+
+        TimingStats productStats;
+        CsrMatrix<int> product = measureRepeated([&]() {
+            return multiplySparseSparse(sparse1, sparse2, numberOfThreads);
+        }, [](const CsrMatrix<int>&) {}, productStats);
+        double productTime = productStats.median;
+
+        cout << "- Running sparse x sparse multiplication:" << endl;
+        cout << "   - Time: " << productTime << "ms (" << calculateGops(n, m, l, productTime) << " dense-equivalent GOP/s), " << product.nonzeros() << " nonzeros" << endl;
+        printTimingStats(productStats);
+        recordBenchmark("sparse-sparse", size, numberOfThreads, productStats);
+        if (referenceResult != nullptr) {
+            int** dense = toDenseMatrix(product, numberOfThreads);
+            cout << "   - Speedup over " << (runSequential ? "sequential" : "parallel") << ": " << calculateSpeedup(referenceTime, productTime) << "x" << endl;
+            cout << "   - Matrices equal: " << (areMatricesEqual(referenceResult, dense, n, l) ? "Yes" : "No") << endl;
+            freeMatrix(dense, n);
+        }
+    }
+
+    if (isVariantSelected("microkernel")) {
+        double frequencyGhz = cpuFrequencyOverrideGhz > 0 ? cpuFrequencyOverrideGhz : cpuFrequencyGhz();
+        double bandwidth = measureMemoryBandwidth(numberOfThreads);
+        // Every element of A, B and C crosses the memory bus at least once
+        double intensity = 2.0 * n * m * l / (sizeof(int) * (double(n) * m + double(m) * l + double(n) * l));
+
+        cout << endl << "- Roofline (clock " << frequencyGhz << " GHz, " << physicalCoreCount() << " physical cores, copy bandwidth " << bandwidth << " GB/s, "
+             << intensity << " ops/byte):" << endl;
+
+        for (const GemmMicroKernels& kernel : availableMicroKernels()) {
+            double time = runVariant("microkernel-" + string(kernel.name), string(kernel.name) + " micro-kernel multiplication (" + to_string(kernel.mr) + "x" + to_string(kernel.nr) + " tile)", numberOfThreads, [&]() {
+                return multiplyMatricesMicroKernel(matrix1, matrix2, n, m, l, numberOfThreads, kernel);
+            });
+
+            double achieved = calculateGops(n, m, l, time);
+            double peak = peakIntegerGops(kernel.vectorWidth, numberOfThreads, frequencyGhz);
+            double memoryRoof = intensity * bandwidth;
+
+            if (peak > 0) {
+                double attainable = min(peak, memoryRoof);
+                cout << "   - Peak: " << peak << " GOP/s, attainable: " << attainable << " GOP/s ("
+                     << (memoryRoof < peak ? "memory" : "compute") << "-bound), achieved "
+                     << int(achieved / attainable * 100) << "% of attainable" << endl;
+            } else {
+                cout << "   - Peak: unknown clock, pass --cpu-ghz" << endl;
+            }
+        }
+    }
+    cout << endl;
+
+    if (isVariantSelected("typed") && (runSequential || runParallel)) {
+        cout << "=====================" << endl << endl;
+        cout << "- Typed multiplication (values below 100, int32 sums stay exact up to m = " << INT_MAX / (99 * 99) << "):" << endl;
+
+        // 64-bit sums cannot overflow here, every typed result and the int result are checked against them
+        long long** exactResult = multiplyMatricesExact(matrix1, matrix2, n, m, l);
+        cout << "   - Parallel path: packed blocks and thread grid of the int multiplication, Scalar micro-kernel for every type," << endl;
+        cout << "     then the widest pmaddwd kernel for int8 and int16 (int32 has no SIMD kernel)" << endl;
+
+        if (referenceResult != nullptr) {
+            cout << "   - int results exact: " << (isProductExact(referenceResult, exactResult, n, l) ? "Yes" : "No (int overflow)") << endl;
+        }
+        cout << endl;
+
+        benchmarkTyped(GemmType<int8_t, int32_t>{ "int8" }, matrix1, matrix2, n, m, l, numberOfThreads, runSequential, runParallel, exactResult);
+        benchmarkTyped(GemmType<int16_t, int32_t>{ "int16" }, matrix1, matrix2, n, m, l, numberOfThreads, runSequential, runParallel, exactResult);
+        benchmarkTyped(GemmType<int32_t, long long>{ "int32" }, matrix1, matrix2, n, m, l, numberOfThreads, runSequential, runParallel, exactResult);
+        cout << endl;
+
+        freeMatrix(exactResult, n);
     }
 
     if (runSequential && runParallel) {
@@ -221,13 +2164,35 @@ void benchmark(
         cout << "   - Parallel time: " << multiplyParallelBenchmark.time << "ms" << endl;
         cout << "   - Speedup: " << speedup << "x" << endl;
         cout << "   - Efficiency: " << int(efficiency * 100) << "%" << " (took " << multiplyParallelBenchmark.time << "ms vs " << multiplySequentialBenchmark.time / numberOfThreads << "ms ideal)" << endl;
+        printCounterSummary("Sequential counters", multiplySequentialBenchmark.stats.counters);
+        printCounterSummary("Parallel counters", multiplyParallelBenchmark.stats.counters);
         cout << "   - Matrices equal: " << (areEqual ? "Yes" : "No") << endl << endl;
     }
+
+    // Clean up, benchmark runs once per point of a sweep
+    freeMatrix(matrix1, n);
+    freeMatrix(matrix2, m);
+    if (runSequential) {
+        freeMatrix(multiplySequentialBenchmark.result, n);
+    }
+    if (runParallel) {
+        freeMatrix(multiplyParallelBenchmark.result, n);
+    }
 }
 
 int main(int argc, char* argv[]) {
+    Options options = parseOptions(argc, argv);
+
     if (argc < 5) {
         cout << "Usage: <n> <m> <l> <threads> [runSequential] [runParallel]" << endl;
+        cout << "Options: --pin --numa-placement --simulate-numa=<nodes>" << endl;
+        cout << "         --variants=<name,...> --kc=<L1 block> --mc=<L2 block> --nc=<L3 block>" << endl;
+        cout << "         --cpu-ghz=<clock for the roofline peak> --grid=<rows>x<columns>x<k-splits>" << endl;
+        cout << "         --strassen-cutoff=<size> --types=<int8,int16,int32>" << endl;
+        cout << "         --density=<fraction of nonzeros, 0-1> --batch=<number of products>" << endl;
+        cout << "         " << benchmarkUsage() << endl;
+        cout << "         " << reportUsage() << endl;
+        cout << "Variants: transposed, ikj, tiled, rowbycolumn, microkernel, typed, sparse (when named or --density < 1), strassen (only when named)" << endl;
         return 1;
     }
 
@@ -239,8 +2204,64 @@ int main(int argc, char* argv[]) {
     bool runSequential = argc < 6 || atoi(argv[5]) == 1;
     bool runParallel = argc < 7 || atoi(argv[6]) == 1;
 
+    configureBenchmark(options);
+    configureReport(options);
+
+    NumaSettings numaSettings;
+    numaSettings.shouldPinThreads = options.has("pin");
+    numaSettings.shouldPrintPlacement = options.has("numa-placement");
+    numaSettings.simulatedNodes = options.getInt("simulate-numa");
+
+    gemmBlockSizes.kc = max(1, options.getInt("kc", gemmBlockSizes.kc));
+    gemmBlockSizes.mc = max(1, options.getInt("mc", gemmBlockSizes.mc));
+    gemmBlockSizes.nc = max(1, options.getInt("nc", gemmBlockSizes.nc));
+
+    cpuFrequencyOverrideGhz = options.getDouble("cpu-ghz");
+    matrixDensity = min(1.0, max(0.0, options.getDouble("density", matrixDensity)));
+    strassenCutoff = max(1, options.getInt("strassen-cutoff", strassenCutoff));
+
+    if (options.has("grid")) {
+        unsigned int rowParts = 0, columnParts = 0, depthParts = 0;
+        if (sscanf(options.getString("grid").c_str(), "%ux%ux%u", &rowParts, &columnParts, &depthParts) == 3 && rowParts > 0 && columnParts > 0 && depthParts > 0) {
+            forcedGemmPartition = { rowParts, columnParts, depthParts };
+        } else {
+            cout << "Ignoring --grid, expected <rows>x<columns>x<k-splits>" << endl;
+        }
+    }
+
+    stringstream variantList(options.getString("variants"));
+    string variant;
+    while (getline(variantList, variant, ',')) {
+        if (!variant.empty()) {
+            selectedVariants.push_back(variant);
+        }
+    }
+
+    stringstream typeList(options.getString("types"));
+    string type;
+    while (getline(typeList, type, ',')) {
+        if (!type.empty()) {
+            selectedTypes.push_back(type);
+        }
+    }
+
     srand(time(NULL)); // Seed the random number generator
-    benchmark(n, m, l, threads, runSequential, runParallel);
+
+    if (options.has("batch")) {
+        benchmarkBatched(n, m, l, threads, max(1, options.getInt("batch")));
+        writeBenchmarkReport("lab-2");
+        return 0;
+    }
+
+    // --sizes sweeps square n x n by n x n products
+    bool isSizeSweep = options.has("sizes");
+    for (unsigned int size : sweepSizes(options, n)) {
+        for (unsigned int sweepThreadCount : sweepThreads(options, threads)) {
+            benchmark(isSizeSweep ? size : n, isSizeSweep ? size : m, isSizeSweep ? size : l, sweepThreadCount, runSequential, runParallel, numaSettings);
+        }
+    }
+
+    writeBenchmarkReport("lab-2");
 
     return 0;
 }
@@ -6,6 +6,16 @@
 #include <vector>
 #include <chrono>
 #include <cmath>
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+#include "../common/thread_pool.h"
+#include "../common/options.h"
+#include "../common/benchmark.h"
+#include "../common/report.h"
+#include "../common/linear_algebra.h"
+#include "../common/csr.h" // Sparse systems and nonzero-balanced partitioning
 
 using namespace std;
 
@@ -30,6 +40,35 @@ int** generateDiagonallyDominantMatrix(int n) {
     return matrix;
 }
 
+// Generate a symmetric diagonally dominant matrix with a positive diagonal, which is positive
+// definite, so both the Jacobi methods and conjugate gradient converge on it
+int** generateSymmetricPositiveDefiniteMatrix(int n) {
+    int** matrix = new int*[n];
+
+    for (int i = 0; i < n; i++) {
+        matrix[i] = new int[n];
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = i + 1; j < n; j++) {
+            matrix[i][j] = rand() % 10; // Random values from 0 to 9
+            matrix[j][i] = matrix[i][j];
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        int sum = 0;
+        for (int j = 0; j < n; j++) {
+            if (i != j) {
+                sum += abs(matrix[i][j]);
+            }
+        }
+        matrix[i][i] = sum + rand() % 10 + 1; // Ensure strict diagonal dominance
+    }
+
+    return matrix;
+}
+
 // Generate a random vector
 int* generateVector(int n) {
     int* vector = new int[n];
@@ -41,119 +80,889 @@ int* generateVector(int n) {
     return vector;
 }
 
-// Sequential Jacobi method
-double* solveJacobiSequential(
+// Sparse system for the Jacobi method: the off-diagonal part of A in CSR or ELLPACK storage and the
+// diagonal on its own, so the row loops need no `j != i` test and the division becomes a multiplication
+template <typename Matrix>
+struct SparseSystem {
+    Matrix offDiagonal;
+    vector<double> diagonal;
+    vector<double> inverseDiagonal;
+    vector<int> b;
+};
+
+// Generate a sparse diagonally dominant system without ever holding the dense matrix. Row i has
+// the band |i - j| <= bandwidth and on average `scattered` more nonzeros at random columns, so
+// the rows differ in length the way the rows of real systems do.
+SparseSystem<CsrMatrix<int>> generateSparseSystem(
+    unsigned int n,
+    unsigned int bandwidth,
+    unsigned int scattered
+) {
+    SparseSystem<CsrMatrix<int>> system;
+    CsrMatrix<int>& matrix = system.offDiagonal;
+    matrix.rows = n;
+    matrix.cols = n;
+    matrix.rowStart.assign(n + 1, 0);
+    matrix.columns.reserve(size_t(n) * (2 * bandwidth + scattered));
+    matrix.values.reserve(size_t(n) * (2 * bandwidth + scattered));
+    system.diagonal.resize(n);
+    system.inverseDiagonal.resize(n);
+    system.b.resize(n);
+
+    vector<unsigned int> rowColumns;
+    for (unsigned int i = 0; i < n; i++) {
+        rowColumns.clear();
+        for (unsigned int j = i > bandwidth ? i - bandwidth : 0; j <= i + bandwidth && j < n; j++) {
+            rowColumns.push_back(j);
+        }
+        unsigned int extra = scattered > 0 ? rand() % (2 * scattered + 1) : 0;
+        for (unsigned int k = 0; k < extra; k++) {
+            rowColumns.push_back(rand() % n);
+        }
+        sort(rowColumns.begin(), rowColumns.end());
+        rowColumns.erase(unique(rowColumns.begin(), rowColumns.end()), rowColumns.end());
+
+        int sum = 0;
+        for (unsigned int j : rowColumns) {
+            if (j != i) {
+                int value = rand() % 9 + 1; // Random values from 1 to 9, zeros would not be stored
+                matrix.columns.push_back(j);
+                matrix.values.push_back(value);
+                sum += value;
+            }
+        }
+        matrix.rowStart[i + 1] = matrix.columns.size();
+
+        // Make the diagonal element larger than the sum of the others
+        system.diagonal[i] = sum + rand() % 10 + 1;
+        system.inverseDiagonal[i] = 1.0 / system.diagonal[i];
+        system.b[i] = rand() % 10; // Random values from 0 to 9
+    }
+
+    return system;
+}
+
+// The same system with the off-diagonal part in ELLPACK storage
+SparseSystem<EllMatrix<int>> toEllSystem(
+    const SparseSystem<CsrMatrix<int>>& system,
+    unsigned int numberOfThreads
+) {
+    SparseSystem<EllMatrix<int>> ellSystem;
+    ellSystem.offDiagonal = toEllMatrix(system.offDiagonal, numberOfThreads);
+    ellSystem.diagonal = system.diagonal;
+    ellSystem.inverseDiagonal = system.inverseDiagonal;
+    ellSystem.b = system.b;
+    return ellSystem;
+}
+
+// Convergence test of the solvers, set by --norm, --stop and --check-every
+enum class Norm {
+    L1,
+    L2,
+    Max, // L-infinity
+};
+
+struct ConvergenceCriterion {
+    Norm norm = Norm::L1;
+    bool useResidual = false; // Norm of b - Ax instead of the norm of the update x_new - x_old
+    unsigned int checkInterval = 1; // Test every K-th iteration only
+};
+
+ConvergenceCriterion convergence;
+
+const char* normName(Norm norm) {
+    switch (norm) {
+        case Norm::L1: return "L1";
+        case Norm::L2: return "L2";
+        default: return "L-infinity";
+    }
+}
+
+// Add one element to a running norm: sum of |v|, sum of v^2 or max |v|
+inline double accumulateNorm(
+    Norm norm,
+    double accumulated,
+    double value
+) {
+    switch (norm) {
+        case Norm::L1: return accumulated + abs(value);
+        case Norm::L2: return accumulated + value * value;
+        default: return max(accumulated, abs(value));
+    }
+}
+
+// Merge two running norms of disjoint parts of a vector
+inline double combineNorms(
+    Norm norm,
+    double first,
+    double second
+) {
+    return norm == Norm::Max ? max(first, second) : first + second;
+}
+
+inline double finishNorm(
+    Norm norm,
+    double accumulated
+) {
+    return norm == Norm::L2 ? sqrt(accumulated) : accumulated;
+}
+
+// One Jacobi step for rows [startRow, endRow): next = current + (b - A current) / diag(A).
+// The full row product gives the residual of `current` for free, so either criterion is fused
+// into the update. Returns the running norm of the rows, 0 when `shouldMeasure` is false.
+inline double updateJacobiRows(
     int** A,
     int* b,
     int n,
+    const double* current,
+    double* next,
+    unsigned int startRow,
+    unsigned int endRow,
+    bool shouldMeasure
+) {
+    double accumulated = 0.0;
+
+    for (unsigned int i = startRow; i < endRow; i++) {
+        double residual = b[i] - dotProduct(A[i], current, n);
+        double update = residual / A[i][i];
+        next[i] = current[i] + update;
+
+        if (shouldMeasure) {
+            accumulated = accumulateNorm(convergence.norm, accumulated, convergence.useResidual ? residual : update);
+        }
+    }
+
+    return accumulated;
+}
+
+// Jacobi iterations of a system with n unknowns on one thread. The matrix storage is hidden in
+// `updateRows(current, next, startRow, endRow, shouldMeasure)`, which works like updateJacobiRows.
+template <typename UpdateRows>
+double* iterateJacobiSequential(
+    unsigned int n,
     int maxIterations,
-    double tolerance
+    double tolerance,
+    UpdateRows updateRows,
+    int* iterationsDone
 ) {
     double* x_old = new double[n];
     double* x_new = new double[n];
 
     // Initialize x to zero
-    for (int i = 0; i < n; i++) {
+    for (unsigned int i = 0; i < n; i++) {
         x_old[i] = 0.0;
     }
 
-    for (int iter = 0; iter < maxIterations; iter++) {
-        for (int i = 0; i < n; i++) {
-            double sigma = 0.0;
-            for (int j = 0; j < n; j++) {
-                if (j != i) {
-                    sigma += A[i][j] * x_old[j];
-                }
+    int iter = 0;
+    while (iter < maxIterations) {
+        bool shouldCheck = (iter + 1) % convergence.checkInterval == 0;
+        double error = finishNorm(convergence.norm, updateRows(x_old, x_new, 0, n, shouldCheck));
+        iter++;
+
+        // The residual belongs to x_old, which is then the solution
+        if (shouldCheck && convergence.useResidual && error < tolerance) {
+            break;
+        }
+
+        // The new iterate becomes the old one without copying
+        swap(x_old, x_new);
+
+        if (shouldCheck && error < tolerance) {
+            break;
+        }
+    }
+
+    if (iterationsDone != nullptr) {
+        *iterationsDone = iter;
+    }
+
+    delete[] x_new;
+
+    return x_old; // x_old holds the solution
+}
+
+// Jacobi iterations of a system with n unknowns on the shared pool, thread t updates the rows
+// `partition(numberOfThreads, t)`.
+//
+// The workers stay in one parallel region for the whole solve. An iteration is: update the own rows
+// and measure their part of the norm, meet at the barrier, combine the partial norms. Every thread
+// computes the same total, so all of them stop at the same iteration without a second barrier.
+// The partial norms are double-buffered by iteration parity: a thread can only write the slot of
+// iteration k + 2 after everyone has passed the barrier of iteration k + 1, that is after everyone
+// has read iteration k. Iterations between two checks skip the norm and the combining.
+template <typename Partition, typename UpdateRows>
+double* iterateJacobiParallel(
+    unsigned int n,
+    int maxIterations,
+    double tolerance,
+    unsigned int numberOfThreads,
+    Partition partition,
+    UpdateRows updateRows,
+    int* iterationsDone
+) {
+    double* x_old = new double[n];
+    double* x_new = new double[n];
+
+    numberOfThreads = max(1u, effectiveThreads(n, numberOfThreads));
+    vector<PartialSum> partialErrors(2 * numberOfThreads);
+    SpinBarrier barrier(numberOfThreads);
+    double* solution = x_old;
+    int iterations = 0;
+
+    parallelRun(numberOfThreads, [&](unsigned int threadIndex) {
+        Range rows = partition(numberOfThreads, threadIndex);
+        double* current = x_old;
+        double* next = x_new;
+
+        // Initialize x to zero, each thread its own rows
+        for (unsigned int i = rows.start; i < rows.end; i++) {
+            current[i] = 0.0;
+        }
+        barrier.wait();
+
+        int iter = 0;
+        while (iter < maxIterations) {
+            bool shouldCheck = (iter + 1) % convergence.checkInterval == 0;
+            double error = updateRows(current, next, rows.start, rows.end, shouldCheck);
+
+            PartialSum* iterationErrors = &partialErrors[(iter % 2) * numberOfThreads];
+            iterationErrors[threadIndex].value = error;
+            barrier.wait();
+            iter++;
+
+            if (!shouldCheck) {
+                swap(current, next);
+                continue;
+            }
+
+            double totalError = 0.0;
+            for (unsigned int t = 0; t < numberOfThreads; t++) {
+                totalError = combineNorms(convergence.norm, totalError, iterationErrors[t].value);
+            }
+            totalError = finishNorm(convergence.norm, totalError);
+
+            // The residual belongs to `current`, which is then the solution
+            if (convergence.useResidual && totalError < tolerance) {
+                break;
+            }
+
+            swap(current, next);
+
+            if (totalError < tolerance) {
+                break;
             }
-            x_new[i] = (b[i] - sigma) / A[i][i];
         }
 
-        // Check for convergence
-        double error = 0.0;
-        for (int i = 0; i < n; i++) {
-            error += abs(x_new[i] - x_old[i]);
-            x_old[i] = x_new[i];
+        if (threadIndex == 0) {
+            solution = current;
+            iterations = iter;
         }
+    });
 
-        if (error < tolerance) {
-            break;
+    if (iterationsDone != nullptr) {
+        *iterationsDone = iterations;
+    }
+
+    delete[] (solution == x_old ? x_new : x_old);
+
+    return solution;
+}
+
+// Sequential Jacobi method
+double* solveJacobiSequential(
+    int** A,
+    int* b,
+    int n,
+    int maxIterations,
+    double tolerance,
+    int* iterationsDone = nullptr
+) {
+    auto updateRows = [&](const double* current, double* next, unsigned int startRow, unsigned int endRow, bool shouldMeasure) {
+        return updateJacobiRows(A, b, n, current, next, startRow, endRow, shouldMeasure);
+    };
+
+    return iterateJacobiSequential(n, maxIterations, tolerance, updateRows, iterationsDone);
+}
+
+// Parallel Jacobi method, the rows are split evenly among the threads
+double* solveJacobiParallel(
+    int** A,
+    int* b,
+    int n,
+    int maxIterations,
+    double tolerance,
+    unsigned int numberOfThreads,
+    int* iterationsDone = nullptr
+) {
+    auto partition = [&](unsigned int threads, unsigned int threadIndex) {
+        return partitionRange(0, n, threads, threadIndex);
+    };
+    auto updateRows = [&](const double* current, double* next, unsigned int startRow, unsigned int endRow, bool shouldMeasure) {
+        return updateJacobiRows(A, b, n, current, next, startRow, endRow, shouldMeasure);
+    };
+
+    return iterateJacobiParallel(n, maxIterations, tolerance, numberOfThreads, partition, updateRows, iterationsDone);
+}
+
+// y[i] = off-diagonal row i . x for rows [startRow, endRow) of a CSR matrix
+inline void multiplyOffDiagonal(
+    const CsrMatrix<int>& matrix,
+    const double* x,
+    double* y,
+    unsigned int startRow,
+    unsigned int endRow
+) {
+    for (unsigned int i = startRow; i < endRow; i++) {
+        double sum = 0.0;
+        for (size_t position = matrix.rowStart[i]; position < matrix.rowStart[i + 1]; position++) {
+            sum += matrix.values[position] * x[matrix.columns[position]];
+        }
+        y[i] = sum;
+    }
+}
+
+// The same for an ELLPACK matrix, in blocks of rows that go through the slots together: the
+// products of one slot are independent, so the block loop vectorizes where a row loop cannot
+inline void multiplyOffDiagonal(
+    const EllMatrix<int>& matrix,
+    const double* x,
+    double* y,
+    unsigned int startRow,
+    unsigned int endRow
+) {
+    const unsigned int BLOCK_ROWS = 64;
+    double sums[BLOCK_ROWS];
+
+    for (unsigned int blockStart = startRow; blockStart < endRow; blockStart += BLOCK_ROWS) {
+        unsigned int blockRows = min(BLOCK_ROWS, endRow - blockStart);
+        for (unsigned int i = 0; i < blockRows; i++) {
+            sums[i] = 0.0;
+        }
+
+        for (unsigned int k = 0; k < matrix.width; k++) {
+            const int* values = &matrix.values[matrix.slot(blockStart, k)];
+            const unsigned int* columns = &matrix.columns[matrix.slot(blockStart, k)];
+            for (unsigned int i = 0; i < blockRows; i++) {
+                sums[i] += values[i] * x[columns[i]];
+            }
+        }
+
+        for (unsigned int i = 0; i < blockRows; i++) {
+            y[blockStart + i] = sums[i];
+        }
+    }
+}
+
+// One Jacobi step for rows [startRow, endRow) of a sparse system, like updateJacobiRows.
+// The residual is diag(A) times the update, so either criterion is still fused into the step.
+template <typename Matrix>
+inline double updateSparseJacobiRows(
+    const SparseSystem<Matrix>& system,
+    const double* current,
+    double* next,
+    unsigned int startRow,
+    unsigned int endRow,
+    bool shouldMeasure
+) {
+    multiplyOffDiagonal(system.offDiagonal, current, next, startRow, endRow);
+
+    double accumulated = 0.0;
+    for (unsigned int i = startRow; i < endRow; i++) {
+        next[i] = (system.b[i] - next[i]) * system.inverseDiagonal[i];
+
+        if (shouldMeasure) {
+            double update = next[i] - current[i];
+            accumulated = accumulateNorm(convergence.norm, accumulated, convergence.useResidual ? update * system.diagonal[i] : update);
         }
     }
 
-    delete[] x_old;
+    return accumulated;
+}
 
-    return x_new; // x_new contains the solution
+// Sequential Jacobi method for a sparse system
+template <typename Matrix>
+double* solveJacobiSequential(
+    const SparseSystem<Matrix>& system,
+    int maxIterations,
+    double tolerance,
+    int* iterationsDone = nullptr
+) {
+    auto updateRows = [&](const double* current, double* next, unsigned int startRow, unsigned int endRow, bool shouldMeasure) {
+        return updateSparseJacobiRows(system, current, next, startRow, endRow, shouldMeasure);
+    };
+
+    return iterateJacobiSequential(system.offDiagonal.rows, maxIterations, tolerance, updateRows, iterationsDone);
 }
 
-// Parallel Jacobi method
+// Parallel Jacobi method for a sparse system. The threads get about the same number of nonzeros
+// instead of the same number of rows, so a part full of long rows does not hold up the others.
+template <typename Matrix>
 double* solveJacobiParallel(
+    const SparseSystem<Matrix>& system,
+    int maxIterations,
+    double tolerance,
+    unsigned int numberOfThreads,
+    int* iterationsDone = nullptr
+) {
+    vector<unsigned long long> prefix = nonzeroPrefix(system.offDiagonal);
+
+    auto partition = [&](unsigned int threads, unsigned int threadIndex) {
+        return partitionByWeight(prefix, threads, threadIndex);
+    };
+    auto updateRows = [&](const double* current, double* next, unsigned int startRow, unsigned int endRow, bool shouldMeasure) {
+        return updateSparseJacobiRows(system, current, next, startRow, endRow, shouldMeasure);
+    };
+
+    return iterateJacobiParallel(system.offDiagonal.rows, maxIterations, tolerance, numberOfThreads, partition, updateRows, iterationsDone);
+}
+
+// Norm of b - Ax over rows [startRow, endRow) of a sparse system, before finishNorm
+inline double sparseResidualRows(
+    const SparseSystem<CsrMatrix<int>>& system,
+    const double* x,
+    unsigned int startRow,
+    unsigned int endRow
+) {
+    const CsrMatrix<int>& matrix = system.offDiagonal;
+    double accumulated = 0.0;
+    for (unsigned int i = startRow; i < endRow; i++) {
+        double sum = system.diagonal[i] * x[i];
+        for (size_t position = matrix.rowStart[i]; position < matrix.rowStart[i + 1]; position++) {
+            sum += matrix.values[position] * x[matrix.columns[position]];
+        }
+        accumulated = accumulateNorm(convergence.norm, accumulated, system.b[i] - sum);
+    }
+    return accumulated;
+}
+
+// Parallel multicolor SOR method for a sparse system, over-relaxed by `omega` (0 < omega < 2).
+//
+// No two rows of a color of `coloring` touch each other's unknowns, so every color is relaxed in
+// place by all threads at once, each taking a part of its rows, and sees the new values of the
+// colors before it: a Gauss-Seidel sweep in color order. There is one barrier per color, so the
+// sweep pays colorCount barriers where Jacobi pays one, and needs far fewer sweeps for it.
+// The partial norms are double-buffered by iteration parity as in iterateJacobiParallel.
+double* solveMulticolorSorParallel(
+    const SparseSystem<CsrMatrix<int>>& system,
+    const RowColoring& coloring,
+    int maxIterations,
+    double tolerance,
+    double omega,
+    unsigned int numberOfThreads,
+    int* iterationsDone = nullptr
+) {
+    const CsrMatrix<int>& matrix = system.offDiagonal;
+    unsigned int n = matrix.rows;
+    double* x = new double[n];
+
+    numberOfThreads = max(1u, effectiveThreads(n, numberOfThreads));
+    vector<PartialSum> partialErrors(2 * numberOfThreads);
+    SpinBarrier barrier(numberOfThreads);
+    int iterations = 0;
+
+    parallelRun(numberOfThreads, [&](unsigned int threadIndex) {
+        Range rows = partitionRange(0, n, numberOfThreads, threadIndex);
+
+        // Initialize x to zero, each thread its own rows
+        for (unsigned int i = rows.start; i < rows.end; i++) {
+            x[i] = 0.0;
+        }
+        barrier.wait();
+
+        int iter = 0;
+        while (iter < maxIterations) {
+            bool shouldCheck = (iter + 1) % convergence.checkInterval == 0;
+            bool shouldMeasureUpdate = shouldCheck && !convergence.useResidual;
+            double error = 0.0;
+
+            for (unsigned int color = 0; color < coloring.colorCount(); color++) {
+                Range part = partitionRange(coloring.colorStart[color], coloring.colorStart[color + 1], numberOfThreads, threadIndex);
+
+                for (unsigned int k = part.start; k < part.end; k++) {
+                    unsigned int i = coloring.rows[k];
+                    double sum = 0.0;
+                    for (size_t position = matrix.rowStart[i]; position < matrix.rowStart[i + 1]; position++) {
+                        sum += matrix.values[position] * x[matrix.columns[position]];
+                    }
+
+                    double update = omega * ((system.b[i] - sum) * system.inverseDiagonal[i] - x[i]);
+                    x[i] += update;
+
+                    if (shouldMeasureUpdate) {
+                        error = accumulateNorm(convergence.norm, error, update);
+                    }
+                }
+                barrier.wait();
+            }
+            iter++;
+
+            if (!shouldCheck) {
+                continue;
+            }
+
+            // The residual of the new iterate costs one more product with A
+            if (convergence.useResidual) {
+                error = sparseResidualRows(system, x, rows.start, rows.end);
+            }
+
+            PartialSum* iterationErrors = &partialErrors[(iter % 2) * numberOfThreads];
+            iterationErrors[threadIndex].value = error;
+            barrier.wait();
+
+            double totalError = 0.0;
+            for (unsigned int t = 0; t < numberOfThreads; t++) {
+                totalError = combineNorms(convergence.norm, totalError, iterationErrors[t].value);
+            }
+
+            if (finishNorm(convergence.norm, totalError) < tolerance) {
+                break;
+            }
+        }
+
+        if (threadIndex == 0) {
+            iterations = iter;
+        }
+    });
+
+    if (iterationsDone != nullptr) {
+        *iterationsDone = iterations;
+    }
+
+    return x;
+}
+
+// Norm of b - Ax over rows [startRow, endRow), before finishNorm
+inline double residualRows(
+    int** A,
+    int* b,
+    int n,
+    const double* x,
+    unsigned int startRow,
+    unsigned int endRow
+) {
+    double accumulated = 0.0;
+    for (unsigned int i = startRow; i < endRow; i++) {
+        accumulated = accumulateNorm(convergence.norm, accumulated, b[i] - dotProduct(A[i], x, n));
+    }
+    return accumulated;
+}
+
+// SOR step for rows [startRow, endRow): next = current + omega * (b - A x) / diag(A), where x takes
+// its first `split` unknowns from `updated` and the others from `current`. With all three pointing
+// at the same vector the rows are relaxed in place, in order, which is Gauss-Seidel.
+// Returns the running norm of the updates, 0 when `shouldMeasure` is false.
+inline double relaxRows(
+    int** A,
+    int* b,
+    int n,
+    const double* updated,
+    const double* current,
+    double* next,
+    unsigned int startRow,
+    unsigned int endRow,
+    unsigned int split,
+    double omega,
+    bool shouldMeasure
+) {
+    double accumulated = 0.0;
+
+    for (unsigned int i = startRow; i < endRow; i++) {
+        double residual = b[i] - dotProduct(A[i], updated, split) - dotProduct(A[i] + split, current + split, n - split);
+        double update = omega * residual / A[i][i];
+        next[i] = current[i] + update;
+
+        if (shouldMeasure) {
+            accumulated = accumulateNorm(convergence.norm, accumulated, update);
+        }
+    }
+
+    return accumulated;
+}
+
+// Sequential Gauss-Seidel method, over-relaxed by `omega` (1 is plain Gauss-Seidel).
+// Every row uses the unknowns already updated in this sweep, which usually halves the iterations of Jacobi.
+double* solveGaussSeidelSequential(
     int** A,
     int* b,
     int n,
     int maxIterations,
     double tolerance,
-    unsigned int numberOfThreads
+    double omega = 1.0,
+    int* iterationsDone = nullptr
 ) {
-    double* x_old = new double[n];
-    double* x_new = new double[n];
+    double* x = new double[n];
 
     // Initialize x to zero
     for (int i = 0; i < n; i++) {
-        x_old[i] = 0.0;
+        x[i] = 0.0;
+    }
+
+    int iter = 0;
+    while (iter < maxIterations) {
+        bool shouldCheck = (iter + 1) % convergence.checkInterval == 0;
+        double error = relaxRows(A, b, n, x, x, x, 0, n, n, omega, shouldCheck && !convergence.useResidual);
+        iter++;
+
+        // The residual is not a by-product of an in-place sweep, it costs one more product with A
+        if (shouldCheck && convergence.useResidual) {
+            error = residualRows(A, b, n, x, 0, n);
+        }
+
+        if (shouldCheck && finishNorm(convergence.norm, error) < tolerance) {
+            break;
+        }
     }
 
-    if (numberOfThreads > n) {
-        numberOfThreads = n;
+    if (iterationsDone != nullptr) {
+        *iterationsDone = iter;
     }
 
-    unsigned int rowsPerThread = n / numberOfThreads;
-    unsigned int remainingRows = n % numberOfThreads;
+    return x;
+}
+
+// Parallel two-block Jacobi/Gauss-Seidel method, under-relaxed by `omega` (at most 1).
+//
+// A dense matrix has no coloring: every unknown depends on every other, so no two rows can be
+// relaxed at once from each other's new values. The unknowns are cut into two halves instead: the
+// first half is relaxed from the old iterate like Jacobi, then the second half from the new first
+// half like Gauss-Seidel. Each half is split among all threads and the halves are separated by a
+// barrier; the old and new iterates are two vectors swapped after every sweep, as in solveJacobiParallel.
+// Since most of every update is Jacobi-style, over-relaxation slows it down and soon diverges, so it
+// only takes omega up to 1. The sparse systems have a real coloring, see solveMulticolorSorParallel.
+double* solveTwoBlockParallel(
+    int** A,
+    int* b,
+    int n,
+    int maxIterations,
+    double tolerance,
+    double omega,
+    unsigned int numberOfThreads,
+    int* iterationsDone = nullptr
+) {
+    double* x_old = new double[n];
+    double* x_new = new double[n];
 
-    for (int iter = 0; iter < maxIterations; iter++) {
-        std::vector<std::thread> threads;
-        unsigned int currentRow = 0;
+    unsigned int half = n / 2;
+    numberOfThreads = max(1u, effectiveThreads(n, numberOfThreads));
+    vector<PartialSum> partialErrors(2 * numberOfThreads);
+    SpinBarrier barrier(numberOfThreads);
+    double* solution = x_old;
+    int iterations = 0;
 
-        for (unsigned int threadIndex = 0; threadIndex < numberOfThreads; threadIndex++) {
-            // The first `remainingRows` threads will take 1 more row to distribute the remainder
-            bool shouldTakeRemainder = threadIndex < remainingRows;
+    parallelRun(numberOfThreads, [&](unsigned int threadIndex) {
+        Range rows = partitionRange(0, n, numberOfThreads, threadIndex);
+        Range redRows = partitionRange(0, half, numberOfThreads, threadIndex);
+        Range blackRows = partitionRange(half, n, numberOfThreads, threadIndex);
+        double* current = x_old;
+        double* next = x_new;
 
-            unsigned int startRow = currentRow;
-            unsigned int endRow = startRow + rowsPerThread + (shouldTakeRemainder ? 1 : 0);
-            currentRow = endRow;
+        // Initialize x to zero, each thread its own rows
+        for (unsigned int i = rows.start; i < rows.end; i++) {
+            current[i] = 0.0;
+        }
+        barrier.wait();
 
-            threads.push_back(std::thread([=]() {
-                for (unsigned int i = startRow; i < endRow; i++) {
-                    double sigma = 0.0;
-                    for (int j = 0; j < n; j++) {
-                        if (j != i) {
-                            sigma += A[i][j] * x_old[j];
-                        }
-                    }
-                    x_new[i] = (b[i] - sigma) / A[i][i];
+        int iter = 0;
+        while (iter < maxIterations) {
+            bool shouldCheck = (iter + 1) % convergence.checkInterval == 0;
+            bool shouldMeasureUpdate = shouldCheck && !convergence.useResidual;
+
+            double error = relaxRows(A, b, n, next, current, next, redRows.start, redRows.end, 0, omega, shouldMeasureUpdate);
+            barrier.wait();
+
+            error = combineNorms(convergence.norm, error,
+                relaxRows(A, b, n, next, current, next, blackRows.start, blackRows.end, half, omega, shouldMeasureUpdate));
+            barrier.wait();
+            iter++;
+
+            // The residual of the new iterate costs one more product with A and one more barrier
+            if (shouldCheck && convergence.useResidual) {
+                error = residualRows(A, b, n, next, rows.start, rows.end);
+            }
+
+            swap(current, next);
+
+            if (!shouldCheck) {
+                continue;
+            }
+
+            PartialSum* iterationErrors = &partialErrors[(iter % 2) * numberOfThreads];
+            iterationErrors[threadIndex].value = error;
+            barrier.wait();
+
+            double totalError = 0.0;
+            for (unsigned int t = 0; t < numberOfThreads; t++) {
+                totalError = combineNorms(convergence.norm, totalError, iterationErrors[t].value);
+            }
+
+            if (finishNorm(convergence.norm, totalError) < tolerance) {
+                break;
+            }
+        }
+
+        if (threadIndex == 0) {
+            solution = current;
+            iterations = iter;
+        }
+    });
+
+    if (iterationsDone != nullptr) {
+        *iterationsDone = iterations;
+    }
+
+    delete[] (solution == x_old ? x_new : x_old);
+
+    return solution;
+}
+
+// Parallel conjugate gradient method for symmetric positive definite matrices, preconditioned with
+// the inverse of the diagonal (Jacobi preconditioner) when `usePreconditioner` is set.
+//
+// Like solveJacobiParallel it runs in one parallel region. An iteration is three phases separated
+// by barriers: q = A p and the partial p . q, then the updates of x and r with the partial r . z,
+// then the new search direction p, which every thread reads whole in the next product.
+// Each reduction has its own partial sums; a slot is only written again after a barrier that every
+// reader has passed, so they need no double buffering. CG keeps the residual r = b - Ax up to date
+// anyway, so it always stops on the residual in the norm of --norm, checked every iteration.
+double* solveConjugateGradientParallel(
+    int** A,
+    int* b,
+    int n,
+    int maxIterations,
+    double tolerance,
+    unsigned int numberOfThreads,
+    bool usePreconditioner = false,
+    int* iterationsDone = nullptr
+) {
+    double* x = new double[n];
+    vector<double> r(n);
+    vector<double> p(n);
+    vector<double> q(n);
+    vector<double> z(usePreconditioner ? n : 0);
+    vector<double> inverseDiagonal(usePreconditioner ? n : 0);
+    double* preconditioned = usePreconditioner ? z.data() : r.data(); // z = M^-1 r, r itself without M
+
+    numberOfThreads = max(1u, effectiveThreads(n, numberOfThreads));
+    vector<PartialSum> directionSums(numberOfThreads); // p . q
+    vector<PartialSum> residualSums(numberOfThreads); // r . z
+    vector<PartialSum> partialErrors(numberOfThreads);
+    SpinBarrier barrier(numberOfThreads);
+    int iterations = 0;
+
+    parallelRun(numberOfThreads, [&](unsigned int threadIndex) {
+        Range rows = partitionRange(0, n, numberOfThreads, threadIndex);
+        unsigned int count = rows.end - rows.start;
+
+        auto sumOf = [&](const vector<PartialSum>& partialSums) {
+            double sum = 0.0;
+            for (unsigned int t = 0; t < numberOfThreads; t++) {
+                sum += partialSums[t].value;
+            }
+            return sum;
+        };
+
+        // z = M^-1 r for the own rows, returns the partial r . z
+        auto precondition = [&]() {
+            if (usePreconditioner) {
+                for (unsigned int i = rows.start; i < rows.end; i++) {
+                    z[i] = r[i] * inverseDiagonal[i];
                 }
-            }));
+            }
+            return dotProduct(&r[rows.start], &preconditioned[rows.start], count);
+        };
+
+        // x = 0, so r = b and p = z
+        for (unsigned int i = rows.start; i < rows.end; i++) {
+            x[i] = 0.0;
+            r[i] = b[i];
+            if (usePreconditioner) {
+                inverseDiagonal[i] = 1.0 / A[i][i];
+            }
+        }
+        double initialError = 0.0;
+        for (unsigned int i = rows.start; i < rows.end; i++) {
+            initialError = accumulateNorm(convergence.norm, initialError, r[i]);
         }
+        partialErrors[threadIndex].value = initialError;
+        residualSums[threadIndex].value = precondition();
+        for (unsigned int i = rows.start; i < rows.end; i++) {
+            p[i] = preconditioned[i];
+        }
+        barrier.wait();
+
+        double residualProduct = sumOf(residualSums);
 
-        // Wait for all threads to finish
-        for (auto& t : threads) {
-            t.join();
+        // x = 0 may already solve the system (b = 0), then alpha would be 0 / 0
+        double totalInitialError = 0.0;
+        for (unsigned int t = 0; t < numberOfThreads; t++) {
+            totalInitialError = combineNorms(convergence.norm, totalInitialError, partialErrors[t].value);
         }
+        bool isSolved = finishNorm(convergence.norm, totalInitialError) < tolerance || residualProduct == 0;
+
+        int iter = 0;
+        while (!isSolved && iter < maxIterations) {
+            multiplyRows(A, p.data(), q.data(), n, rows.start, rows.end);
+            directionSums[threadIndex].value = dotProduct(&p[rows.start], &q[rows.start], count);
+            barrier.wait();
 
-        // Check for convergence
-        double error = 0.0;
-        for (int i = 0; i < n; i++) {
-            error += abs(x_new[i] - x_old[i]);
-            x_old[i] = x_new[i];
+            double alpha = residualProduct / sumOf(directionSums);
+            axpyRange(alpha, p.data(), x, rows.start, rows.end);
+            axpyRange(-alpha, q.data(), r.data(), rows.start, rows.end);
+
+            double error = 0.0;
+            for (unsigned int i = rows.start; i < rows.end; i++) {
+                error = accumulateNorm(convergence.norm, error, r[i]);
+            }
+            partialErrors[threadIndex].value = error;
+            residualSums[threadIndex].value = precondition();
+            barrier.wait();
+            iter++;
+
+            double totalError = 0.0;
+            for (unsigned int t = 0; t < numberOfThreads; t++) {
+                totalError = combineNorms(convergence.norm, totalError, partialErrors[t].value);
+            }
+            if (finishNorm(convergence.norm, totalError) < tolerance) {
+                break;
+            }
+
+            double nextResidualProduct = sumOf(residualSums);
+            double beta = nextResidualProduct / residualProduct;
+            residualProduct = nextResidualProduct;
+
+            for (unsigned int i = rows.start; i < rows.end; i++) {
+                p[i] = preconditioned[i] + beta * p[i];
+            }
+            barrier.wait();
         }
 
-        if (error < tolerance) {
-            break;
+        if (threadIndex == 0) {
+            iterations = iter;
         }
+    });
+
+    if (iterationsDone != nullptr) {
+        *iterationsDone = iterations;
     }
 
-    delete[] x_old;
+    return x;
+}
+
+// Methods picked with --methods=a,b, all of them when the list is empty. Jacobi always runs.
+vector<string> selectedMethods;
+
+bool isMethodSelected(const string& name) {
+    if (selectedMethods.empty()) {
+        return true;
+    }
 
-    return x_new; // x_new contains the solution
+    for (const string& selected : selectedMethods) {
+        if (selected == name) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
 // Check if two vectors are equal within a tolerance
@@ -193,19 +1002,20 @@ double calculateEfficiency(
 }
 
 struct BenchmarkResult {
-    long long time;
-    double* result;
+    double time; // Median of the timed runs in milliseconds
+    double* result; // Result of the last run
+    TimingStats stats;
 };
 
 BenchmarkResult benchmarkTime(
     function<double*()> function
 ) {
-    auto start = chrono::high_resolution_clock::now();
-    double* result = function();
-    auto end = chrono::high_resolution_clock::now();
-    auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
+    TimingStats stats;
+    double* result = measureRepeated(function, [](double* unused) {
+        delete[] unused;
+    }, stats);
 
-    return { duration.count(), result };
+    return { stats.median, result, stats };
 }
 
 void benchmark(
@@ -214,7 +1024,9 @@ void benchmark(
     int maxIterations = 10000,
     double tolerance = 1e-6,
     bool runSequential = true,
-    bool runParallel = true
+    bool runParallel = true,
+    double omega = 1.0,
+    bool isSymmetric = false
 ) {
     cout << "Benchmark for solving " << n << "x" << n << " system of linear equations with " << numberOfThreads << " threads using Jacobi method" << endl;
     if (!runSequential) {
@@ -223,33 +1035,134 @@ void benchmark(
     if (!runParallel) {
         cout << "- Skipping parallel algorithms" << endl;
     }
+    if (isSymmetric) {
+        cout << "- Symmetric positive definite matrix" << endl;
+    }
+    if (convergence.norm != Norm::L1 || convergence.useResidual || convergence.checkInterval > 1) {
+        cout << "- Stopping when the " << normName(convergence.norm) << " norm of " << (convergence.useResidual ? "b - Ax" : "the update")
+             << " is below " << tolerance << ", checked every " << convergence.checkInterval << " iterations" << endl;
+    }
 
     cout << endl << "=====================" << endl << endl;
 
     cout << "- Generating matrix and vector..." << endl << endl;
-    int** A = generateDiagonallyDominantMatrix(n);
+    int** A = isSymmetric ? generateSymmetricPositiveDefiniteMatrix(n) : generateDiagonallyDominantMatrix(n);
     int* b = generateVector(n);
 
     BenchmarkResult sequentialBenchmark;
     BenchmarkResult parallelBenchmark;
-    cout << "Press any key to continue..." << endl;
-    cin.get();
+    int sequentialIterations = 0;
+    int parallelIterations = 0;
+    waitForKeyPress();
     cout << "=====================" << endl << endl;
 
     if (runSequential) {
         cout << "- Running sequential Jacobi method:" << endl;
         sequentialBenchmark = benchmarkTime([&]() {
-            return solveJacobiSequential(A, b, n, maxIterations, tolerance);
+            return solveJacobiSequential(A, b, n, maxIterations, tolerance, &sequentialIterations);
         });
         cout << "   - Time: " << sequentialBenchmark.time << "ms" << endl;
+        printTimingStats(sequentialBenchmark.stats);
+        cout << "   - Iterations: " << sequentialIterations << endl;
     }
 
     if (runParallel) {
         cout << "- Running parallel Jacobi method:" << endl;
         parallelBenchmark = benchmarkTime([&]() {
-            return solveJacobiParallel(A, b, n, maxIterations, tolerance, numberOfThreads);
+            return solveJacobiParallel(A, b, n, maxIterations, tolerance, numberOfThreads, &parallelIterations);
         });
         cout << "   - Time: " << parallelBenchmark.time << "ms" << endl;
+        printTimingStats(parallelBenchmark.stats);
+        cout << "   - Iterations: " << parallelIterations << endl;
+    }
+
+    string size = to_string(n) + "x" + to_string(n);
+    if (runSequential) {
+        recordBenchmark("jacobi-sequential", size, 1, sequentialBenchmark.stats);
+    }
+    if (runParallel) {
+        double speedup = runSequential ? calculateSpeedup(sequentialBenchmark.time, parallelBenchmark.time) : 0;
+        recordBenchmark("jacobi-parallel", size, numberOfThreads, parallelBenchmark.stats, speedup, calculateEfficiency(speedup, numberOfThreads));
+    }
+
+    // The other methods stop at a different iterate, so they only agree with Jacobi to about sqrt(tolerance)
+    double* referenceSolution = runSequential ? sequentialBenchmark.result : (runParallel ? parallelBenchmark.result : nullptr);
+    double agreement = sqrt(tolerance);
+
+    // Time to solution of every method, printed after the runs
+    struct MethodResult {
+        string name;
+        int iterations;
+        double time;
+    };
+    vector<MethodResult> methodResults;
+    if (runSequential) {
+        methodResults.push_back({ "Jacobi (sequential)", sequentialIterations, sequentialBenchmark.time });
+    }
+    if (runParallel) {
+        methodResults.push_back({ "Jacobi (parallel)", parallelIterations, parallelBenchmark.time });
+    }
+
+    // Speedup and efficiency of a method are against sequential Jacobi, the baseline of this lab
+    auto runMethod = [&](const string& algorithm, const string& name, unsigned int threads, function<double*(int*)> solve) {
+        int iterations = 0;
+        BenchmarkResult methodBenchmark = benchmarkTime([&]() {
+            return solve(&iterations);
+        });
+
+        cout << "- Running " << name << ":" << endl;
+        cout << "   - Time: " << methodBenchmark.time << "ms" << endl;
+        printTimingStats(methodBenchmark.stats);
+        cout << "   - Iterations: " << iterations << endl;
+        if (referenceSolution != nullptr) {
+            cout << "   - Solution agrees with Jacobi to " << agreement << ": " << (areVectorsEqual(referenceSolution, methodBenchmark.result, n, agreement) ? "Yes" : "No") << endl;
+        }
+
+        double speedup = runSequential ? calculateSpeedup(sequentialBenchmark.time, methodBenchmark.time) : 0;
+        recordBenchmark(algorithm, size, threads, methodBenchmark.stats, speedup, calculateEfficiency(speedup, threads));
+        methodResults.push_back({ name, iterations, methodBenchmark.time });
+
+        delete[] methodBenchmark.result;
+    };
+
+    if (runSequential && isMethodSelected("gauss-seidel")) {
+        ostringstream name;
+        name << "sequential Gauss-Seidel method (omega " << omega << ")";
+        runMethod("gauss-seidel-sequential", name.str(), 1, [&](int* iterations) {
+            return solveGaussSeidelSequential(A, b, n, maxIterations, tolerance, omega, iterations);
+        });
+    }
+
+    if (runParallel && isMethodSelected("sor")) {
+        if (omega > 1) {
+            cout << "- Skipping parallel two-block Jacobi/Gauss-Seidel method: it diverges with omega " << omega << ", use at most 1" << endl;
+        } else {
+            ostringstream name;
+            name << "parallel two-block Jacobi/Gauss-Seidel method (omega " << omega << ")";
+            runMethod("two-block-parallel", name.str(), numberOfThreads, [&](int* iterations) {
+                return solveTwoBlockParallel(A, b, n, maxIterations, tolerance, omega, numberOfThreads, iterations);
+            });
+        }
+    }
+
+    // Conjugate gradient needs a symmetric matrix, see --matrix=spd
+    if (runParallel && isSymmetric && isMethodSelected("cg")) {
+        runMethod("cg-parallel", "parallel conjugate gradient method", numberOfThreads, [&](int* iterations) {
+            return solveConjugateGradientParallel(A, b, n, maxIterations, tolerance, numberOfThreads, false, iterations);
+        });
+    }
+
+    if (runParallel && isSymmetric && isMethodSelected("pcg")) {
+        runMethod("pcg-parallel", "parallel Jacobi-preconditioned conjugate gradient method", numberOfThreads, [&](int* iterations) {
+            return solveConjugateGradientParallel(A, b, n, maxIterations, tolerance, numberOfThreads, true, iterations);
+        });
+    }
+
+    if (methodResults.size() > 2) {
+        cout << endl << "- Time to solution:" << endl;
+        for (const MethodResult& method : methodResults) {
+            cout << "   - " << method.name << ": " << method.time << "ms, " << method.iterations << " iterations" << endl;
+        }
     }
 
     if (runSequential && runParallel) {
@@ -266,6 +1179,8 @@ void benchmark(
         cout << "   - Parallel time: " << parallelBenchmark.time << "ms" << endl;
         cout << "   - Speedup: " << speedup << "x" << endl;
         cout << "   - Efficiency: " << int(efficiency * 100) << "%" << endl;
+        printCounterSummary("Sequential counters", sequentialBenchmark.stats.counters);
+        printCounterSummary("Parallel counters", parallelBenchmark.stats.counters);
         cout << "   - Solutions equal: " << (areEqual ? "Yes" : "No") << endl << endl;
     }
 
@@ -283,20 +1198,228 @@ void benchmark(
     }
 }
 
+// Jacobi method on a generated sparse system in CSR and ELLPACK storage, for sizes where the
+// dense matrix would not fit in memory
+void benchmarkSparse(
+    unsigned int n,
+    unsigned int numberOfThreads,
+    int maxIterations = 10000,
+    double tolerance = 1e-6,
+    bool runSequential = true,
+    bool runParallel = true,
+    unsigned int bandwidth = 8,
+    unsigned int scattered = 8,
+    double omega = 1.0
+) {
+    cout << "Benchmark for solving " << n << "x" << n << " sparse system of linear equations with " << numberOfThreads << " threads using Jacobi method" << endl;
+    cout << "- Band of " << bandwidth << " on each side of the diagonal and " << scattered << " scattered nonzeros per row on average" << endl;
+    if (!runSequential) {
+        cout << "- Skipping sequential algorithms" << endl;
+    }
+    if (!runParallel) {
+        cout << "- Skipping parallel algorithms" << endl;
+    }
+    if (convergence.norm != Norm::L1 || convergence.useResidual || convergence.checkInterval > 1) {
+        cout << "- Stopping when the " << normName(convergence.norm) << " norm of " << (convergence.useResidual ? "b - Ax" : "the update")
+             << " is below " << tolerance << ", checked every " << convergence.checkInterval << " iterations" << endl;
+    }
+
+    cout << endl << "=====================" << endl << endl;
+
+    cout << "- Generating sparse matrix and vector..." << endl;
+    SparseSystem<CsrMatrix<int>> csrSystem = generateSparseSystem(n, bandwidth, scattered);
+    SparseSystem<EllMatrix<int>> ellSystem;
+    if (runParallel) {
+        ellSystem = toEllSystem(csrSystem, numberOfThreads);
+    }
+
+    size_t nonzeros = csrSystem.offDiagonal.nonzeros() + n;
+    cout << "   - Nonzeros: " << nonzeros << " (" << double(nonzeros) / n << " per row)" << endl;
+    if (runParallel) {
+        double slots = double(ellSystem.offDiagonal.width) * n;
+        double padding = slots > 0 ? 1 - csrSystem.offDiagonal.nonzeros() / slots : 0;
+        cout << "   - ELLPACK width: " << ellSystem.offDiagonal.width << " (" << int(padding * 100) << "% padding)" << endl;
+    }
+    cout << endl;
+
+    BenchmarkResult sequentialBenchmark;
+    BenchmarkResult csrBenchmark;
+    BenchmarkResult ellBenchmark;
+    int sequentialIterations = 0;
+    int csrIterations = 0;
+    int ellIterations = 0;
+    waitForKeyPress();
+    cout << "=====================" << endl << endl;
+
+    if (runSequential) {
+        cout << "- Running sequential Jacobi method (CSR):" << endl;
+        sequentialBenchmark = benchmarkTime([&]() {
+            return solveJacobiSequential(csrSystem, maxIterations, tolerance, &sequentialIterations);
+        });
+        cout << "   - Time: " << sequentialBenchmark.time << "ms" << endl;
+        printTimingStats(sequentialBenchmark.stats);
+        cout << "   - Iterations: " << sequentialIterations << endl;
+    }
+
+    if (runParallel) {
+        cout << "- Running parallel Jacobi method (CSR):" << endl;
+        csrBenchmark = benchmarkTime([&]() {
+            return solveJacobiParallel(csrSystem, maxIterations, tolerance, numberOfThreads, &csrIterations);
+        });
+        cout << "   - Time: " << csrBenchmark.time << "ms" << endl;
+        printTimingStats(csrBenchmark.stats);
+        cout << "   - Iterations: " << csrIterations << endl;
+
+        cout << "- Running parallel Jacobi method (ELLPACK):" << endl;
+        ellBenchmark = benchmarkTime([&]() {
+            return solveJacobiParallel(ellSystem, maxIterations, tolerance, numberOfThreads, &ellIterations);
+        });
+        cout << "   - Time: " << ellBenchmark.time << "ms" << endl;
+        printTimingStats(ellBenchmark.stats);
+        cout << "   - Iterations: " << ellIterations << endl;
+    }
+
+    string size = to_string(n) + "x" + to_string(n);
+    if (runParallel && isMethodSelected("sor")) {
+        auto coloringStart = chrono::high_resolution_clock::now();
+        RowColoring coloring = colorRows(csrSystem.offDiagonal);
+        auto coloringEnd = chrono::high_resolution_clock::now();
+
+        int sorIterations = 0;
+        BenchmarkResult sorBenchmark = benchmarkTime([&]() {
+            return solveMulticolorSorParallel(csrSystem, coloring, maxIterations, tolerance, omega, numberOfThreads, &sorIterations);
+        });
+
+        cout << "- Running parallel multicolor SOR method (CSR, omega " << omega << "):" << endl;
+        cout << "   - Colors: " << coloring.colorCount() << ", found in " << chrono::duration<double, milli>(coloringEnd - coloringStart).count() << "ms" << endl;
+        cout << "   - Time: " << sorBenchmark.time << "ms" << endl;
+        printTimingStats(sorBenchmark.stats);
+        cout << "   - Iterations: " << sorIterations << endl;
+        // It stops at a different iterate, so it only agrees with Jacobi to about sqrt(tolerance)
+        cout << "   - Solution agrees with Jacobi to " << sqrt(tolerance) << ": " << (areVectorsEqual(csrBenchmark.result, sorBenchmark.result, n, sqrt(tolerance)) ? "Yes" : "No") << endl;
+
+        double speedup = runSequential ? calculateSpeedup(sequentialBenchmark.time, sorBenchmark.time) : 0;
+        recordBenchmark("sor-csr-parallel", size, numberOfThreads, sorBenchmark.stats, speedup, calculateEfficiency(speedup, numberOfThreads));
+        delete[] sorBenchmark.result;
+    }
+
+    if (runSequential) {
+        recordBenchmark("jacobi-csr-sequential", size, 1, sequentialBenchmark.stats);
+    }
+    if (runParallel) {
+        double csrSpeedup = runSequential ? calculateSpeedup(sequentialBenchmark.time, csrBenchmark.time) : 0;
+        double ellSpeedup = runSequential ? calculateSpeedup(sequentialBenchmark.time, ellBenchmark.time) : 0;
+        recordBenchmark("jacobi-csr-parallel", size, numberOfThreads, csrBenchmark.stats, csrSpeedup, calculateEfficiency(csrSpeedup, numberOfThreads));
+        recordBenchmark("jacobi-ell-parallel", size, numberOfThreads, ellBenchmark.stats, ellSpeedup, calculateEfficiency(ellSpeedup, numberOfThreads));
+    }
+
+    if (runSequential && runParallel) {
+        cout << endl << "=====================" << endl << endl;
+        cout << "- Summary:" << endl;
+
+        double csrSpeedup = calculateSpeedup(sequentialBenchmark.time, csrBenchmark.time);
+        double ellSpeedup = calculateSpeedup(sequentialBenchmark.time, ellBenchmark.time);
+        bool areEqual = areVectorsEqual(sequentialBenchmark.result, csrBenchmark.result, n, tolerance)
+            && areVectorsEqual(sequentialBenchmark.result, ellBenchmark.result, n, tolerance);
+
+        cout << "   - System size: " << n << "x" << n << endl;
+        cout << "   - Threads: " << numberOfThreads << endl;
+        cout << "   - Sequential time (CSR): " << sequentialBenchmark.time << "ms" << endl;
+        cout << "   - Parallel time (CSR): " << csrBenchmark.time << "ms" << endl;
+        cout << "   - Parallel time (ELLPACK): " << ellBenchmark.time << "ms" << endl;
+        cout << "   - Speedup (CSR): " << csrSpeedup << "x" << endl;
+        cout << "   - Speedup (ELLPACK): " << ellSpeedup << "x" << endl;
+        cout << "   - Efficiency (CSR): " << int(calculateEfficiency(csrSpeedup, numberOfThreads) * 100) << "%" << endl;
+        cout << "   - Efficiency (ELLPACK): " << int(calculateEfficiency(ellSpeedup, numberOfThreads) * 100) << "%" << endl;
+        printCounterSummary("Sequential counters (CSR)", sequentialBenchmark.stats.counters);
+        printCounterSummary("Parallel counters (CSR)", csrBenchmark.stats.counters);
+        printCounterSummary("Parallel counters (ELLPACK)", ellBenchmark.stats.counters);
+        cout << "   - Solutions equal: " << (areEqual ? "Yes" : "No") << endl << endl;
+    }
+
+    // Clean up
+    if (runSequential) {
+        delete[] sequentialBenchmark.result;
+    }
+    if (runParallel) {
+        delete[] csrBenchmark.result;
+        delete[] ellBenchmark.result;
+    }
+}
+
 int main(int argc, char* argv[]) {
+    Options options = parseOptions(argc, argv);
+
     if (argc < 3) {
         cout << "Usage: <n> <threads> [runSequential] [runParallel]" << endl;
+        cout << "Options: --norm=<l1|l2|linf> --stop=<update|residual> --check-every=<iterations>" << endl;
+        cout << "         --methods=<gauss-seidel,sor,cg,pcg> --omega=<SOR relaxation factor, 0-2, at most 1 for dense sor> --matrix=<dominant|spd>" << endl;
+        cout << "         --sparse --bandwidth=<band on each side> --scattered=<extra nonzeros per row>" << endl;
+        cout << "         " << benchmarkUsage() << " " << reportUsage() << endl;
         return 1;
     }
 
+    configureBenchmark(options);
+    configureReport(options);
+
     unsigned int n = atoi(argv[1]);
     unsigned int threads = atoi(argv[2]);
 
     bool runSequential = argc < 4 || atoi(argv[3]) == 1;
     bool runParallel = argc < 5 || atoi(argv[4]) == 1;
 
+    string norm = options.getString("norm", "l1");
+    if (norm == "l2") {
+        convergence.norm = Norm::L2;
+    } else if (norm == "linf") {
+        convergence.norm = Norm::Max;
+    } else if (norm != "l1") {
+        cout << "Ignoring --norm=" << norm << ", expected l1, l2 or linf" << endl;
+    }
+
+    convergence.useResidual = options.getString("stop", "update") == "residual";
+    convergence.checkInterval = max(1, options.getInt("check-every", 1));
+
+    // SOR only converges for 0 < omega < 2, the dense two-block method only up to 1
+    double omega = options.getDouble("omega", 1.0);
+    if (omega <= 0 || omega >= 2) {
+        cout << "Ignoring --omega=" << omega << ", expected a value between 0 and 2" << endl;
+        omega = 1.0;
+    }
+
+    // cg and pcg only run on the symmetric positive definite systems of --matrix=spd
+    string matrix = options.getString("matrix", "dominant");
+    bool isSymmetric = matrix == "spd";
+    if (!isSymmetric && matrix != "dominant") {
+        cout << "Ignoring --matrix=" << matrix << ", expected dominant or spd" << endl;
+    }
+
+    stringstream methodList(options.getString("methods"));
+    string method;
+    while (getline(methodList, method, ',')) {
+        if (!method.empty()) {
+            selectedMethods.push_back(method);
+        }
+    }
+
+    // Sparse systems skip the dense solvers, whose matrix would not fit at the sizes they are meant for;
+    // of --methods they only run sor, as multicolor SOR
+    bool isSparse = options.has("sparse");
+    unsigned int bandwidth = max(0, options.getInt("bandwidth", 8));
+    unsigned int scattered = max(0, options.getInt("scattered", 8));
+
     srand(time(NULL)); // Seed the random number generator
-    benchmark(n, threads, 10000, 1e-6, runSequential, runParallel);
+    for (unsigned int size : sweepSizes(options, n)) {
+        for (unsigned int sweepThreadCount : sweepThreads(options, threads)) {
+            if (isSparse) {
+                benchmarkSparse(size, sweepThreadCount, 10000, 1e-6, runSequential, runParallel, bandwidth, scattered, omega);
+            } else {
+                benchmark(size, sweepThreadCount, 10000, 1e-6, runSequential, runParallel, omega, isSymmetric);
+            }
+        }
+    }
+
+    writeBenchmarkReport("lab-3");
 
     return 0;
 }
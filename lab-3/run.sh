@@ -2,7 +2,7 @@
 mkdir -p dist
 
 # Compile the code
-g++-14 app.cpp -o dist/app
+g++-14 -O3 -march=native -pthread app.cpp -o dist/app
 
 # Run the code with arguments
 ./dist/app "$@"
@@ -6,6 +6,11 @@
 #include <climits> // Needed for INT_MAX
 #include <chrono> // Needed for time measurements
 
+#include "../common/thread_pool.h" // Shared worker pool and parallelFor
+#include "../common/options.h" // Optional --flags
+#include "../common/benchmark.h" // Warm-up, repetitions and timing statistics
+#include "../common/report.h" // JSON/CSV report and size/thread sweeps
+
 using namespace std;
 
 #define INF INT_MAX / 2
@@ -73,44 +78,20 @@ int** computeFloydParallel(int** graph, int n, unsigned int numberOfThreads) {
     }
 
     for (int k = 0; k < n; k++) {
-        // No need to use more threads than rows
-        if (numberOfThreads > n) {
-            numberOfThreads = n;
-        }
-
-        unsigned int rowsPerThread = n / numberOfThreads;
-        unsigned int remainingRows = n % numberOfThreads;
-
-        thread* threads = new thread[numberOfThreads];
-
-        unsigned int currentRow = 0;
-
-        for (unsigned int threadIndex = 0; threadIndex < numberOfThreads; threadIndex++) {
-            unsigned int startRow = currentRow;
-            unsigned int endRow = startRow + rowsPerThread + (threadIndex < remainingRows ? 1 : 0);
-            currentRow = endRow;
-
-            threads[threadIndex] = thread([=]() {
-                for (unsigned int i = startRow; i < endRow; i++) {
-                    for (int j = 0; j < n; j++) {
-                        if (
-                            dist[i][k] != INF &&
-                            dist[k][j] != INF &&
-                            dist[i][j] > dist[i][k] + dist[k][j]
-                        ) {
-                            dist[i][j] = dist[i][k] + dist[k][j];
-                        }
+        // One parallel region per k on the shared pool, the threads are not recreated
+        parallelFor(0, n, numberOfThreads, [=](unsigned int startRow, unsigned int endRow) {
+            for (unsigned int i = startRow; i < endRow; i++) {
+                for (int j = 0; j < n; j++) {
+                    if (
+                        dist[i][k] != INF &&
+                        dist[k][j] != INF &&
+                        dist[i][j] > dist[i][k] + dist[k][j]
+                    ) {
+                        dist[i][j] = dist[i][k] + dist[k][j];
                     }
                 }
-            });
-        }
-
-        // Join threads
-        for (unsigned int i = 0; i < numberOfThreads; i++) {
-            threads[i].join();
-        }
-
-        delete[] threads;
+            }
+        });
     }
 
     return dist;
@@ -140,17 +121,21 @@ double calculateEfficiency(double speedup, int numberOfThreads) {
 }
 
 struct BenchmarkResult {
-    long long time;
-    int** result;
+    double time; // Median of the timed runs in milliseconds
+    int** result; // Result of the last run
+    TimingStats stats;
 };
 
-BenchmarkResult benchmarkTime(function<int**()> function) {
-    auto start = chrono::high_resolution_clock::now();
-    int** result = function();
-    auto end = chrono::high_resolution_clock::now();
-    auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
+BenchmarkResult benchmarkTime(function<int**()> function, unsigned int rows) {
+    TimingStats stats;
+    int** result = measureRepeated(function, [&](int** unused) {
+        for (unsigned int i = 0; i < rows; i++) {
+            delete[] unused[i];
+        }
+        delete[] unused;
+    }, stats);
 
-    return { duration.count(), result };
+    return { stats.median, result, stats };
 }
 
 void benchmark(
@@ -179,8 +164,7 @@ void benchmark(
     BenchmarkResult sequentialBenchmark;
     BenchmarkResult parallelBenchmark;
 
-    cout << "Press any key to continue..." << endl;
-    cin.get();
+    waitForKeyPress();
     cout << "=====================" << endl << endl;
 
     if (runSequential) {
@@ -188,8 +172,9 @@ void benchmark(
 
         sequentialBenchmark = benchmarkTime([&]() {
             return computeFloydSequential(graph, n);
-        });
+        }, n);
         cout << "   - Time: " << sequentialBenchmark.time << "ms" << endl;
+        printTimingStats(sequentialBenchmark.stats);
         cout << "   - Shortest path from " << a << " to " << b << " length: " << sequentialBenchmark.result[a][b] << endl << endl;
     }
 
@@ -198,9 +183,23 @@ void benchmark(
 
         parallelBenchmark = benchmarkTime([&]() {
             return computeFloydParallel(graph, n, numberOfThreads);
-        });
+        }, n);
         cout << "   - Time: " << parallelBenchmark.time << "ms" << endl;
-        cout << "   - Shortest path from " << a << " to " << b << " length: " << parallelBenchmark.result[a][b] << endl << endl;
+        printTimingStats(parallelBenchmark.stats);
+        cout << "   - Shortest path from " << a << " to " << b << " length: " << parallelBenchmark.result[a][b] << endl;
+
+        // The parallel version runs one region per k, so this overhead is paid n times
+        double dispatchOverhead = measurePoolDispatchOverhead(numberOfThreads);
+        cout << "   - Dispatch overhead: " << dispatchOverhead << "us per region (" << dispatchOverhead * n / 1000 << "ms for " << n << " regions)" << endl << endl;
+    }
+
+    string size = to_string(n) + " vertices";
+    if (runSequential) {
+        recordBenchmark("floyd-sequential", size, 1, sequentialBenchmark.stats);
+    }
+    if (runParallel) {
+        double speedup = runSequential ? calculateSpeedup(sequentialBenchmark.time, parallelBenchmark.time) : 0;
+        recordBenchmark("floyd-parallel", size, numberOfThreads, parallelBenchmark.stats, speedup, calculateEfficiency(speedup, numberOfThreads));
     }
 
     if (runSequential && runParallel) {
@@ -218,13 +217,40 @@ void benchmark(
 
         cout << "   - Speedup: " << speedup << "x" << endl;
         cout << "   - Efficiency: " << int(efficiency * 100) << "% (took " << parallelBenchmark.time << "ms vs " << sequentialBenchmark.time / numberOfThreads << "ms ideal)" << endl;
+        printCounterSummary("Sequential counters", sequentialBenchmark.stats.counters);
+        printCounterSummary("Parallel counters", parallelBenchmark.stats.counters);
         cout << "   - Shortest paths equal: " << (areEqual ? "Yes" : "No") << endl << endl;
     }
+
+    // Clean up results
+    for (unsigned int i = 0; i < n; i++) {
+        if (runSequential) {
+            delete[] sequentialBenchmark.result[i];
+        }
+        if (runParallel) {
+            delete[] parallelBenchmark.result[i];
+        }
+    }
+    if (runSequential) {
+        delete[] sequentialBenchmark.result;
+    }
+    if (runParallel) {
+        delete[] parallelBenchmark.result;
+    }
+
+    // Clean up graph
+    for (unsigned int i = 0; i < n; i++) {
+        delete[] graph[i];
+    }
+    delete[] graph;
 }
 
 int main(int argc, char* argv[]) {
+    Options options = parseOptions(argc, argv);
+
     if (argc < 5) {
         cout << "Usage: <n> <threads> <a> <b> [runSequential] [runParallel]" << endl;
+        cout << "Options: " << benchmarkUsage() << " " << reportUsage() << endl;
         return 1;
     }
 
@@ -233,7 +259,7 @@ int main(int argc, char* argv[]) {
     int a = atoi(argv[3]);
     int b = atoi(argv[4]);
 
-    if (a < 0 || a >= n || b < 0 || b >= n) {
+    if (a < 0 || (unsigned int)a >= n || b < 0 || (unsigned int)b >= n) {
         cout << "Error: Nodes 'a' and 'b' must be between 0 and " << n - 1 << endl;
         return 1;
     }
@@ -241,8 +267,21 @@ int main(int argc, char* argv[]) {
     bool runSequential = argc < 6 || atoi(argv[5]) == 1;
     bool runParallel = argc < 7 || atoi(argv[6]) == 1;
 
+    configureBenchmark(options);
+    configureReport(options);
+
     srand(time(NULL)); // Seed the random number generator
-    benchmark(n, threads, a, b, runSequential, runParallel);
+    for (unsigned int size : sweepSizes(options, n)) {
+        if ((unsigned int)a >= size || (unsigned int)b >= size) {
+            cout << "- Skipping size " << size << ", too small for the given nodes" << endl;
+            continue;
+        }
+        for (unsigned int sweepThreadCount : sweepThreads(options, threads)) {
+            benchmark(size, sweepThreadCount, a, b, runSequential, runParallel);
+        }
+    }
+
+    writeBenchmarkReport("lab-5");
 
     return 0;
 }
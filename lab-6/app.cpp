@@ -7,6 +7,11 @@
 #include <limits>
 #include <mutex>
 
+#include "../common/thread_pool.h"
+#include "../common/options.h"
+#include "../common/benchmark.h"
+#include "../common/report.h"
+
 using namespace std;
 
 struct Graph {
@@ -43,24 +48,16 @@ Graph generateGraphParallel(int numVertices, unsigned int numberOfThreads) {
 
     unsigned int rowsPerThread = numVertices / numberOfThreads;
     unsigned int remainingRows = numVertices % numberOfThreads;
-    thread* threads = new thread[numberOfThreads];
-    unsigned int currentRow = 0;
+    unsigned int baseSeed = static_cast<unsigned int>(time(nullptr));
 
-    for (unsigned int threadIndex = 0; threadIndex < numberOfThreads; threadIndex++) {
+    parallelRun(numberOfThreads, [&](unsigned int threadIndex) {
         bool shouldTakeExtraRow = threadIndex < remainingRows;
-        unsigned int startRow = currentRow;
+        unsigned int startRow = threadIndex * rowsPerThread + (shouldTakeExtraRow ? threadIndex : remainingRows);
         unsigned int endRow = startRow + rowsPerThread + (shouldTakeExtraRow ? 1 : 0);
-        currentRow = endRow;
-
-        unsigned int seed = static_cast<unsigned int>(time(nullptr)) + threadIndex;
-        threads[threadIndex] = thread(initializeRows, startRow, endRow, seed);
-    }
 
-    for (unsigned int i = 0; i < numberOfThreads; i++) {
-        threads[i].join();
-    }
+        initializeRows(startRow, endRow, baseSeed + threadIndex);
+    });
 
-    delete[] threads;
     return graph;
 }
 
@@ -129,39 +126,20 @@ int* dijkstraParallel(Graph& graph, int src, unsigned int numberOfThreads) {
 
         sptSet[u] = true;
 
-        // Divide the work among threads
-        unsigned int verticesPerThread = V / numberOfThreads;
-        unsigned int remainingVertices = V % numberOfThreads;
-        thread* threads = new thread[numberOfThreads];
-        unsigned int currentVertex = 0;
-
-        for (unsigned int threadIndex = 0; threadIndex < numberOfThreads; threadIndex++) {
-            bool shouldTakeRemainder = threadIndex < remainingVertices;
-            unsigned int startVertex = currentVertex;
-            unsigned int endVertex = startVertex + verticesPerThread + (shouldTakeRemainder ? 1 : 0);
-            currentVertex = endVertex;
-
-            // Creating a thread
-            threads[threadIndex] = thread([=, &graph, &dist, &sptSet, &distMutex]() {
-                for (unsigned int v = startVertex; v < endVertex; v++) {
-                    if (!sptSet[v] && graph.adjMatrix[u][v] && dist[u] != numeric_limits<int>::max()) {
-                        int newDist = dist[u] + graph.adjMatrix[u][v];
-                        if (newDist < dist[v]) {
-                            // Lock the mutex before updating shared data
-                            lock_guard<mutex> lock(distMutex);
-                            if (newDist < dist[v])
-                                dist[v] = newDist;
-                        }
+        // Divide the work among the threads of the shared pool
+        parallelFor(0, V, numberOfThreads, [&](unsigned int startVertex, unsigned int endVertex) {
+            for (unsigned int v = startVertex; v < endVertex; v++) {
+                if (!sptSet[v] && graph.adjMatrix[u][v] && dist[u] != numeric_limits<int>::max()) {
+                    int newDist = dist[u] + graph.adjMatrix[u][v];
+                    if (newDist < dist[v]) {
+                        // Lock the mutex before updating shared data
+                        lock_guard<mutex> lock(distMutex);
+                        if (newDist < dist[v])
+                            dist[v] = newDist;
                     }
                 }
-            });
-        }
-
-        for (unsigned int i = 0; i < numberOfThreads; i++) {
-            threads[i].join();
-        }
-
-        delete[] threads;
+            }
+        });
     }
 
     delete[] sptSet;
@@ -187,17 +165,18 @@ double calculateEfficiency(double speedup, int numberOfThreads) {
 }
 
 struct BenchmarkResult {
-    long long time;
-    int* result;
+    double time; // Median of the timed runs in milliseconds
+    int* result; // Result of the last run
+    TimingStats stats;
 };
 
 BenchmarkResult benchmarkTime(function<int*()> function) {
-    auto start = chrono::high_resolution_clock::now();
-    int* result = function();
-    auto end = chrono::high_resolution_clock::now();
-    auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
+    TimingStats stats;
+    int* result = measureRepeated(function, [](int* unused) {
+        delete[] unused;
+    }, stats);
 
-    return { duration.count(), result };
+    return { stats.median, result, stats };
 }
 
 void benchmark(
@@ -224,8 +203,7 @@ void benchmark(
     auto graphGenerationDuration = chrono::duration_cast<chrono::milliseconds>(graphGenerationEnd - graphGenerationStart);
     cout << "Graph generated in " << graphGenerationDuration.count() << "ms" << endl << endl;
 
-    cout << "Press any key to continue..." << endl;
-    cin.get();
+    waitForKeyPress();
     cout << "=====================" << endl << endl;
 
     BenchmarkResult sequentialBenchmark;
@@ -237,7 +215,9 @@ void benchmark(
         sequentialBenchmark = benchmarkTime([&]() {
             return dijkstraSequential(graph, sourceNode);
         });
-        cout << "   - Time: " << sequentialBenchmark.time << "ms" << endl << endl;
+        cout << "   - Time: " << sequentialBenchmark.time << "ms" << endl;
+        printTimingStats(sequentialBenchmark.stats);
+        cout << endl;
     }
 
     if (runParallel) {
@@ -246,7 +226,18 @@ void benchmark(
         parallelBenchmark = benchmarkTime([&]() {
             return dijkstraParallel(graph, sourceNode, numberOfThreads);
         });
-        cout << "   - Time: " << parallelBenchmark.time << "ms" << endl << endl;
+        cout << "   - Time: " << parallelBenchmark.time << "ms" << endl;
+        printTimingStats(parallelBenchmark.stats);
+        cout << endl;
+    }
+
+    string size = to_string(numVertices) + " vertices";
+    if (runSequential) {
+        recordBenchmark("dijkstra-sequential", size, 1, sequentialBenchmark.stats);
+    }
+    if (runParallel) {
+        double speedup = runSequential ? calculateSpeedup(sequentialBenchmark.time, parallelBenchmark.time) : 0;
+        recordBenchmark("dijkstra-parallel", size, numberOfThreads, parallelBenchmark.stats, speedup, calculateEfficiency(speedup, numberOfThreads));
     }
 
     if (runSequential && runParallel) {
@@ -265,26 +256,38 @@ void benchmark(
         cout << "   - Parallel time: " << parallelBenchmark.time << "ms" << endl;
         cout << "   - Speedup: " << speedup << "x" << endl;
         cout << "   - Efficiency: " << int(efficiency * 100) << "%" << " (took " << parallelBenchmark.time << "ms vs " << sequentialBenchmark.time / numberOfThreads << "ms ideal)" << endl;
+        printCounterSummary("Sequential counters", sequentialBenchmark.stats.counters);
+        printCounterSummary("Parallel counters", parallelBenchmark.stats.counters);
         cout << "   - Shortest paths length equal: " << (areEqual ? "Yes" : "No") << endl << endl;
+    }
 
-        // Clean up results
+    // Clean up results
+    if (runSequential) {
         delete[] sequentialBenchmark.result;
+    }
+    if (runParallel) {
         delete[] parallelBenchmark.result;
     }
 
     // Clean up graph
-    for (int i = 0; i < numVertices; i++) {
+    for (unsigned int i = 0; i < numVertices; i++) {
         delete[] graph.adjMatrix[i];
     }
     delete[] graph.adjMatrix;
 }
 
 int main(int argc, char* argv[]) {
+    Options options = parseOptions(argc, argv);
+
     if (argc < 4) {
         cout << "Usage: <numVertices> <threads> <sourceNode> [runSequential] [runParallel]" << endl;
+        cout << "Options: " << benchmarkUsage() << " " << reportUsage() << endl;
         return 1;
     }
 
+    configureBenchmark(options);
+    configureReport(options);
+
     unsigned int numVertices = atoi(argv[1]);
     unsigned int threads = atoi(argv[2]);
     int sourceNode = atoi(argv[3]);
@@ -292,7 +295,17 @@ int main(int argc, char* argv[]) {
     bool runSequential = argc < 5 || atoi(argv[4]) == 1;
     bool runParallel = argc < 6 || atoi(argv[5]) == 1;
 
-    benchmark(numVertices, threads, sourceNode, runSequential, runParallel);
+    for (unsigned int size : sweepSizes(options, numVertices)) {
+        if ((unsigned int)sourceNode >= size) {
+            cout << "- Skipping size " << size << ", too small for the given nodes" << endl;
+            continue;
+        }
+        for (unsigned int sweepThreadCount : sweepThreads(options, threads)) {
+            benchmark(size, sweepThreadCount, sourceNode, runSequential, runParallel);
+        }
+    }
+
+    writeBenchmarkReport("lab-6");
 
     return 0;
 }
@@ -6,6 +6,11 @@
 #include <limits>
 #include <mutex>
 
+#include "../common/thread_pool.h"
+#include "../common/options.h"
+#include "../common/benchmark.h"
+#include "../common/report.h"
+
 using namespace std;
 
 void generateGraph(int n, double** graph) {
@@ -110,30 +115,23 @@ void primParallel(int n, double** graph, int startNode, int* parent, int numThre
 
         double* localMinKeys = new double[numThreads];
         int* localMinVertices = new int[numThreads];
-        thread* threads = new thread[numThreads];
 
-        for(int t = 0; t < numThreads; ++t) {
+        // Потоки беруться зі спільного пулу, а не створюються на кожній ітерації
+        parallelRun(numThreads, [&](unsigned int t) {
             int start = t * chunkSize;
             int end = (start + chunkSize < n) ? start + chunkSize : n;
 
-            threads[t] = thread([&, t, start, end]() {
-                double minKey = numeric_limits<double>::infinity();
-                int minVertex = -1;
-                for(int v = start; v < end; ++v) {
-                    if(!inMST[v] && key[v] < minKey) {
-                        minKey = key[v];
-                        minVertex = v;
-                    }
+            double minKey = numeric_limits<double>::infinity();
+            int minVertex = -1;
+            for(int v = start; v < end; ++v) {
+                if(!inMST[v] && key[v] < minKey) {
+                    minKey = key[v];
+                    minVertex = v;
                 }
-                localMinKeys[t] = minKey;
-                localMinVertices[t] = minVertex;
-            });
-        }
-
-        // Очікуємо завершення потоків
-        for(int t = 0; t < numThreads; ++t) {
-            threads[t].join();
-        }
+            }
+            localMinKeys[t] = minKey;
+            localMinVertices[t] = minVertex;
+        });
 
         // Знаходимо глобальний мінімум
         for(int t = 0; t < numThreads; ++t) {
@@ -144,7 +142,6 @@ void primParallel(int n, double** graph, int startNode, int* parent, int numThre
         }
         delete[] localMinKeys;
         delete[] localMinVertices;
-        delete[] threads;
 
         if(u == -1) {
             break;
@@ -152,25 +149,18 @@ void primParallel(int n, double** graph, int startNode, int* parent, int numThre
         inMST[u] = true;
 
         // Паралельна частина: оновлюємо ключі та батьків
-        threads = new thread[numThreads];
-        for(int t = 0; t < numThreads; ++t) {
+        parallelRun(numThreads, [&](unsigned int t) {
             int start = t * chunkSize;
             int end = (start + chunkSize < n) ? start + chunkSize : n;
 
-            threads[t] = thread([&, u, start, end]() {
-                for(int v = start; v < end; ++v) {
-                    if(graph[u][v] != 0 && !inMST[v] && graph[u][v] < key[v]) {
-                        lock_guard<mutex> lock(mtx);
-                        key[v] = graph[u][v];
-                        parent[v] = u;
-                    }
+            for(int v = start; v < end; ++v) {
+                if(graph[u][v] != 0 && !inMST[v] && graph[u][v] < key[v]) {
+                    lock_guard<mutex> lock(mtx);
+                    key[v] = graph[u][v];
+                    parent[v] = u;
                 }
-            });
-        }
-        for(int t = 0; t < numThreads; ++t) {
-            threads[t].join();
-        }
-        delete[] threads;
+            }
+        });
     }
 
     delete[] inMST;
@@ -196,30 +186,33 @@ double calculateEfficiency(double speedup, int numberOfThreads) {
 }
 
 struct BenchmarkResult {
-    long long time;
-    int* result;
+    double time; // Median of the timed runs in milliseconds
+    int* result; // Result of the last run
+    TimingStats stats;
 };
 
-BenchmarkResult benchmarkSequentialTime(int n, double** graph, int startNode) {
+// The parent array is allocated outside the timed part, as before
+BenchmarkResult benchmarkTime(function<void(int*)> function, int n) {
+    TimingStats stats;
     int* parent = new int[n];
+    measureRepeated([&]() {
+        function(parent);
+        return 0;
+    }, [](int) {}, stats);
 
-    auto start = chrono::high_resolution_clock::now();
-    primSequential(n, graph, startNode, parent);
-    auto end = chrono::high_resolution_clock::now();
-    auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
+    return { stats.median, parent, stats };
+}
 
-    return { duration.count(), parent };
+BenchmarkResult benchmarkSequentialTime(int n, double** graph, int startNode) {
+    return benchmarkTime([&](int* parent) {
+        primSequential(n, graph, startNode, parent);
+    }, n);
 }
 
 BenchmarkResult benchmarkParallelTime(int n, double** graph, int startNode, int numThreads) {
-    int* parent = new int[n];
-
-    auto start = chrono::high_resolution_clock::now();
-    primParallel(n, graph, startNode, parent, numThreads);
-    auto end = chrono::high_resolution_clock::now();
-    auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
-
-    return { duration.count(), parent };
+    return benchmarkTime([&](int* parent) {
+        primParallel(n, graph, startNode, parent, numThreads);
+    }, n);
 }
 
 void benchmark(
@@ -243,15 +236,14 @@ void benchmark(
     auto graphGenerationStart = chrono::high_resolution_clock::now();
 
     double** graph = new double*[numVertices];
-    for(int i = 0; i < numVertices; ++i) graph[i] = new double[numVertices];
+    for(unsigned int i = 0; i < numVertices; ++i) graph[i] = new double[numVertices];
     generateGraph(numVertices, graph);
 
     auto graphGenerationEnd = chrono::high_resolution_clock::now();
     auto graphGenerationDuration = chrono::duration_cast<chrono::milliseconds>(graphGenerationEnd - graphGenerationStart);
     cout << "Graph generated in " << graphGenerationDuration.count() << "ms" << endl << endl;
 
-    cout << "Press any key to continue..." << endl;
-    cin.get();
+    waitForKeyPress();
     cout << "=====================" << endl << endl;
 
     BenchmarkResult sequentialBenchmark;
@@ -261,14 +253,27 @@ void benchmark(
         cout << "- Running sequential algorithm:" << endl;
 
         sequentialBenchmark = benchmarkSequentialTime(numVertices, graph, sourceNode);
-        cout << "   - Time: " << sequentialBenchmark.time << "ms" << endl << endl;
+        cout << "   - Time: " << sequentialBenchmark.time << "ms" << endl;
+        printTimingStats(sequentialBenchmark.stats);
+        cout << endl;
     }
 
     if (runParallel) {
         cout << "- Running parallel algorithm:" << endl;
 
         parallelBenchmark = benchmarkParallelTime(numVertices, graph, sourceNode, numberOfThreads);
-        cout << "   - Time: " << parallelBenchmark.time << "ms" << endl << endl;
+        cout << "   - Time: " << parallelBenchmark.time << "ms" << endl;
+        printTimingStats(parallelBenchmark.stats);
+        cout << endl;
+    }
+
+    string size = to_string(numVertices) + " vertices";
+    if (runSequential) {
+        recordBenchmark("prim-sequential", size, 1, sequentialBenchmark.stats);
+    }
+    if (runParallel) {
+        double speedup = runSequential ? calculateSpeedup(sequentialBenchmark.time, parallelBenchmark.time) : 0;
+        recordBenchmark("prim-parallel", size, numberOfThreads, parallelBenchmark.stats, speedup, calculateEfficiency(speedup, numberOfThreads));
     }
 
     if (runSequential && runParallel) {
@@ -287,26 +292,38 @@ void benchmark(
         cout << "   - Parallel time: " << parallelBenchmark.time << "ms" << endl;
         cout << "   - Speedup: " << speedup << "x" << endl;
         cout << "   - Efficiency: " << int(efficiency * 100) << "%" << " (took " << parallelBenchmark.time << "ms vs " << sequentialBenchmark.time / numberOfThreads << "ms ideal)" << endl;
+        printCounterSummary("Sequential counters", sequentialBenchmark.stats.counters);
+        printCounterSummary("Parallel counters", parallelBenchmark.stats.counters);
         cout << "   - MST equal: " << (areEqual ? "Yes" : "No") << endl << endl;
+    }
 
-        // Clean up results
+    // Clean up results
+    if (runSequential) {
         delete[] sequentialBenchmark.result;
+    }
+    if (runParallel) {
         delete[] parallelBenchmark.result;
     }
 
     // Clean up graph
-    for(int i = 0; i < numVertices; ++i) {
+    for(unsigned int i = 0; i < numVertices; ++i) {
         delete[] graph[i];
     }
     delete[] graph;
 }
 
 int main(int argc, char* argv[]) {
+    Options options = parseOptions(argc, argv);
+
     if (argc < 4) {
         cout << "Usage: <numVertices> <threads> <sourceNode> [runSequential] [runParallel]" << endl;
+        cout << "Options: " << benchmarkUsage() << " " << reportUsage() << endl;
         return 1;
     }
 
+    configureBenchmark(options);
+    configureReport(options);
+
     unsigned int numVertices = atoi(argv[1]);
     unsigned int threads = atoi(argv[2]);
     int sourceNode = atoi(argv[3]);
@@ -314,7 +331,17 @@ int main(int argc, char* argv[]) {
     bool runSequential = argc < 5 || atoi(argv[4]) == 1;
     bool runParallel = argc < 6 || atoi(argv[5]) == 1;
 
-    benchmark(numVertices, threads, sourceNode, runSequential, runParallel);
+    for (unsigned int size : sweepSizes(options, numVertices)) {
+        if ((unsigned int)sourceNode >= size) {
+            cout << "- Skipping size " << size << ", too small for the given nodes" << endl;
+            continue;
+        }
+        for (unsigned int sweepThreadCount : sweepThreads(options, threads)) {
+            benchmark(size, sweepThreadCount, sourceNode, runSequential, runParallel);
+        }
+    }
+
+    writeBenchmarkReport("lab-7");
 
     return 0;
 }
@@ -6,6 +6,11 @@
 #include <chrono>   // For timing
 #include <cstring>  // For strlen
 
+#include "../common/thread_pool.h" // Shared worker pool and parallelFor
+#include "../common/options.h" // Optional --flags
+#include "../common/benchmark.h" // Warm-up, repetitions and timing statistics
+#include "../common/report.h" // JSON/CSV report and size/thread sweeps
+
 // Include OpenCL headers
 #ifdef __APPLE__
 #include <OpenCL/opencl.h>
@@ -50,47 +55,20 @@ int** multiplyMatricesSequential(int** matrix1, int** matrix2, unsigned int n, u
 
 // Parallel matrix multiplication
 int** multiplyMatricesParallel(int** matrix1, int** matrix2, unsigned int n, unsigned int m, unsigned int l, unsigned int numberOfThreads) {
-    // No need to use more threads than rows
-    if (numberOfThreads > n) {
-        numberOfThreads = n;
-    }
-
     int** result = new int*[n];
     for (unsigned int i = 0; i < n; i++) {
         result[i] = new int[l];
     }
 
-    unsigned int rowsPerThread = n / numberOfThreads;
-    unsigned int remainingRows = n % numberOfThreads;
-
-    thread* threads = new thread[numberOfThreads];
-
-    unsigned int currentRow = 0;
-
-    for (unsigned int threadIndex = 0; threadIndex < numberOfThreads; threadIndex++) {
-        // The first remainingRows threads will take 1 more row to distribute the remainder
-        bool shouldTakeRemainder = threadIndex < remainingRows;
-
-        unsigned int startRow = currentRow;
-        unsigned int endRow = startRow + rowsPerThread + (shouldTakeRemainder ? 1 : 0);
-        currentRow = endRow;
-
-        // Creating a thread
-        threads[threadIndex] = thread([=]() {
-            for (unsigned int i = startRow; i < endRow; i++) {
-                for (unsigned int j = 0; j < l; j++) {
-                    result[i][j] = multiplyRowByColumn(matrix1[i], matrix2, j, m);
-                }
+    // Rows are split between the threads of the shared pool,
+    // the first `n % numberOfThreads` threads take 1 more row to distribute the remainder
+    parallelFor(0, n, numberOfThreads, [&](unsigned int startRow, unsigned int endRow) {
+        for (unsigned int i = startRow; i < endRow; i++) {
+            for (unsigned int j = 0; j < l; j++) {
+                result[i][j] = multiplyRowByColumn(matrix1[i], matrix2, j, m);
             }
-        });
-    }
-
-    // Starting the threads
-    for (unsigned int i = 0; i < numberOfThreads; i++) {
-        threads[i].join();
-    }
-
-    delete[] threads;
+        }
+    });
 
     return result;
 }
@@ -315,18 +293,22 @@ double calculateEfficiency(double speedup, int numberOfThreads) {
 }
 
 struct BenchmarkResult {
-    long long time;
-    int** result;
+    double time; // Median of the timed runs in milliseconds
+    int** result; // Result of the last run
+    TimingStats stats;
 };
 
-// Benchmarking function
-BenchmarkResult benchmarkTime(function<int**()> function) {
-    auto start = chrono::high_resolution_clock::now();
-    int** result = function();
-    auto end = chrono::high_resolution_clock::now();
-    auto duration = chrono::duration_cast<chrono::milliseconds>(end - start);
+// Benchmarking function, frees the `rows`-row results of all runs but the last
+BenchmarkResult benchmarkTime(function<int**()> function, unsigned int rows) {
+    TimingStats stats;
+    int** result = measureRepeated(function, [&](int** unused) {
+        for (unsigned int i = 0; i < rows; i++) {
+            delete[] unused[i];
+        }
+        delete[] unused;
+    }, stats);
 
-    return { duration.count(), result };
+    return { stats.median, result, stats };
 }
 
 void benchmark(unsigned int n, unsigned int m, unsigned int l, unsigned int numberOfThreads, bool runSequential = true, bool runParallel = true, bool runOpenCL = true) {
@@ -351,32 +333,47 @@ void benchmark(unsigned int n, unsigned int m, unsigned int l, unsigned int numb
     BenchmarkResult multiplyParallelBenchmark;
     BenchmarkResult multiplyOpenCLBenchmark;
 
-    cout << "Press Enter to continue..." << endl;
-    cin.get();
+    waitForKeyPress();
     cout << "=====================" << endl << endl;
 
     if (runSequential) {
         cout << "- Running sequential matrix multiplication:" << endl;
         multiplySequentialBenchmark = benchmarkTime([&]() {
             return multiplyMatricesSequential(matrix1, matrix2, n, m, l);
-        });
+        }, n);
         cout << "   - Time: " << multiplySequentialBenchmark.time << "ms" << endl;
+        printTimingStats(multiplySequentialBenchmark.stats);
     }
 
     if (runParallel) {
         cout << "- Running parallel matrix multiplication:" << endl;
         multiplyParallelBenchmark = benchmarkTime([&]() {
             return multiplyMatricesParallel(matrix1, matrix2, n, m, l, numberOfThreads);
-        });
+        }, n);
         cout << "   - Time: " << multiplyParallelBenchmark.time << "ms" << endl;
+        printTimingStats(multiplyParallelBenchmark.stats);
     }
 
     if (runOpenCL) {
         cout << "- Running OpenCL matrix multiplication:" << endl;
         multiplyOpenCLBenchmark = benchmarkTime([&]() {
             return multiplyMatricesOpenCL(matrix1, matrix2, n, m, l);
-        });
+        }, n);
         cout << "   - Time: " << multiplyOpenCLBenchmark.time << "ms" << endl;
+        printTimingStats(multiplyOpenCLBenchmark.stats);
+    }
+
+    string size = to_string(n) + "x" + to_string(m) + "x" + to_string(l);
+    if (runSequential) {
+        recordBenchmark("multiply-sequential", size, 1, multiplySequentialBenchmark.stats);
+    }
+    if (runParallel) {
+        double speedup = runSequential ? calculateSpeedup(multiplySequentialBenchmark.time, multiplyParallelBenchmark.time) : 0;
+        recordBenchmark("multiply-parallel", size, numberOfThreads, multiplyParallelBenchmark.stats, speedup, calculateEfficiency(speedup, numberOfThreads));
+    }
+    if (runOpenCL) {
+        double speedup = runSequential ? calculateSpeedup(multiplySequentialBenchmark.time, multiplyOpenCLBenchmark.time) : 0;
+        recordBenchmark("multiply-opencl", size, 0, multiplyOpenCLBenchmark.stats, speedup); // 0 threads: runs on the device
     }
 
     cout << "=====================" << endl << endl;
@@ -399,6 +396,8 @@ void benchmark(unsigned int n, unsigned int m, unsigned int l, unsigned int numb
         double efficiency = calculateEfficiency(speedup, numberOfThreads);
         cout << "   - Speedup (Parallel): " << speedup << "x" << endl;
         cout << "   - Efficiency (Parallel): " << int(efficiency * 100) << "%" << endl;
+        printCounterSummary("Sequential counters", multiplySequentialBenchmark.stats.counters);
+        printCounterSummary("Parallel counters", multiplyParallelBenchmark.stats.counters);
         bool areEqual = areMatricesEqual(multiplySequentialBenchmark.result, multiplyParallelBenchmark.result, n, l);
         cout << "   - Matrices equal (Sequential vs Parallel): " << (areEqual ? "Yes" : "No") << endl;
     }
@@ -444,11 +443,17 @@ void benchmark(unsigned int n, unsigned int m, unsigned int l, unsigned int numb
 }
 
 int main(int argc, char* argv[]) {
+    Options options = parseOptions(argc, argv);
+
     if (argc < 5) {
         cout << "Usage: <n> <m> <l> <threads> [runSequential] [runParallel] [runOpenCL]" << endl;
+        cout << "Options: " << benchmarkUsage() << " " << reportUsage() << endl;
         return 1;
     }
 
+    configureBenchmark(options);
+    configureReport(options);
+
     unsigned int n = atoi(argv[1]);
     unsigned int m = atoi(argv[2]);
     unsigned int l = atoi(argv[3]);
@@ -459,7 +464,15 @@ int main(int argc, char* argv[]) {
     bool runOpenCL = argc < 8 || atoi(argv[7]) == 1;
 
     srand(time(NULL)); // Seed the random number generator
-    benchmark(n, m, l, threads, runSequential, runParallel, runOpenCL);
+    // --sizes sweeps square n x n by n x n products
+    bool isSizeSweep = options.has("sizes");
+    for (unsigned int size : sweepSizes(options, n)) {
+        for (unsigned int sweepThreadCount : sweepThreads(options, threads)) {
+            benchmark(isSizeSweep ? size : n, isSizeSweep ? size : m, isSizeSweep ? size : l, sweepThreadCount, runSequential, runParallel, runOpenCL);
+        }
+    }
+
+    writeBenchmarkReport("lab-8");
 
     return 0;
 }
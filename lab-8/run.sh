@@ -1,8 +1,13 @@
 # Create dist folder if not exists
 mkdir -p dist
 
-# Compile the code
-g++-14 app.cpp -framework OpenCL -o dist/app
+# Compile the code, OpenCL is a framework on macOS and a library everywhere else
+if [ "$(uname)" = "Darwin" ]; then
+    OPENCL_FLAGS="-framework OpenCL"
+else
+    OPENCL_FLAGS="-lOpenCL"
+fi
+g++-14 -O3 -march=native -pthread -DCL_TARGET_OPENCL_VERSION=120 app.cpp $OPENCL_FLAGS -o dist/app
 
 # Run the code with arguments
 ./dist/app "$@"
@@ -113,27 +113,28 @@ int main(int argc, char* argv[]) {
     int** parallelResult = NULL;
     double sequentialTime = 0.0, parallelTime = 0.0;
 
+    // MPI_Wtime is wall-clock time; clock() only counted the CPU time of this process
     if (rank == 0 && runSequential) {
-        clock_t start = clock();
+        double start = MPI_Wtime();
         sequentialResult = multiplyMatricesSequential(matrix1, matrix2, n, m, l);
-        clock_t end = clock();
-        sequentialTime = (double)(end - start) / CLOCKS_PER_SEC * 1000;
+        double end = MPI_Wtime();
+        sequentialTime = (end - start) * 1000;
     }
 
     MPI_Bcast(&(matrix2[0][0]), m * l, MPI_INT, 0, MPI_COMM_WORLD);
 
     MPI_Barrier(MPI_COMM_WORLD);
-    clock_t parallelStart = clock();
+    double parallelStart = MPI_Wtime();
 
     int** localResult = multiplyMatricesParallel(matrix1, matrix2, n, m, l, rank, size);
     if (rank == 0) parallelResult = generateMatrix(n, l);
     gatherResults(parallelResult, localResult, n, l, rank, size);
 
     MPI_Barrier(MPI_COMM_WORLD);
-    clock_t parallelEnd = clock();
+    double parallelEnd = MPI_Wtime();
 
     if (rank == 0 && runParallel) {
-        parallelTime = (double)(parallelEnd - parallelStart) / CLOCKS_PER_SEC * 1000;
+        parallelTime = (parallelEnd - parallelStart) * 1000;
         double speedup = sequentialTime / parallelTime;
         double efficiency = speedup / threads * 100;
 
@@ -151,8 +152,8 @@ int main(int argc, char* argv[]) {
 
         printf("   - Matrix size: %dx%d to %dx%d\n", n, m, m, l);
         printf("   - Threads: %d\n", threads);
-        printf("   - Sequential time: %.2f ms\n", sequentialTime);
-        printf("   - Parallel time: %.2f ms\n", parallelTime);
+        printf("   - Sequential time: %.3f ms\n", sequentialTime);
+        printf("   - Parallel time: %.3f ms\n", parallelTime);
         printf("   - Speedup: %.2fx\n", speedup);
         printf("   - Efficiency: %.2f%%\n", efficiency);
         printf("   - Matrices equal: %s\n\n", matricesEqual ? "Yes" : "No");